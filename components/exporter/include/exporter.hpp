@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "logger.hpp"
+#include "task.hpp"
+
+/// Streams the plot samples or the logs held by the display back to a
+/// requester over UDP or TCP, in chunks, from its own task. The data is read
+/// through the getters a chunk (or a snapshot of the samples) at a time, so
+/// that ingest and rendering only ever wait for a copy.
+///
+/// Plots are exported as CSV (`series,index,value` lines) or as binary
+/// SeriesRecords, and logs as text. Over UDP, each chunk is a datagram which
+/// only holds complete lines / records (except for the logs), and an empty
+/// datagram marks the end of the export; over TCP, the connection is closed.
+class Exporter {
+public:
+  enum class Content { PLOTS, LOGS };
+  enum class Format { CSV, BINARY, TEXT };
+  enum class Transport { UDP, TCP };
+
+  struct Request {
+    Content content{Content::PLOTS};
+    Format format{Format::CSV};
+    Transport transport{Transport::UDP};
+    std::string ip;
+    size_t port{0};
+  };
+
+  typedef std::vector<std::pair<std::string, std::vector<int32_t>>> PlotSamples;
+  typedef std::function<PlotSamples()> get_plot_samples_fn;
+  typedef std::function<std::string(size_t offset, size_t max_size)> get_logs_fn;
+
+  struct Config {
+    get_plot_samples_fn get_plot_samples; ///< Snapshot of the samples of all plots
+    get_logs_fn get_logs;                 ///< Up to max_size bytes of the logs from offset
+    size_t chunk_size{1024};              ///< Maximum size of each chunk / datagram
+    espp::Logger::Verbosity log_level{espp::Logger::Verbosity::WARN}; ///< Log level
+  };
+
+  explicit Exporter(const Config &config)
+      : config_(config)
+      , logger_({.tag = "Exporter", .level = config.log_level}) {}
+
+  /// Parse a request from `<plots|logs>,<csv|bin|text>,<port>[,<udp|tcp>[,<ip>]]`,
+  /// where the ip defaults to default_ip (e.g. the address of the requester).
+  static std::optional<Request> parse_request(const std::string &args,
+                                              const std::string &default_ip);
+
+  /// Start streaming, returning false if the request is invalid or an export
+  /// is already running.
+  bool start(const Request &request);
+
+  bool is_running() const { return running_; }
+
+protected:
+  typedef std::function<bool(std::string_view chunk)> send_fn;
+
+  void run(const Request &request);
+  bool send_csv(const send_fn &send);
+  bool send_binary(const send_fn &send);
+  bool send_logs(const send_fn &send);
+
+  Config config_;
+  std::atomic<bool> running_{false};
+  std::unique_ptr<espp::Task> task_;
+  espp::Logger logger_;
+};
@@ -0,0 +1,198 @@
+#include "exporter.hpp"
+
+#include <sstream>
+#include <thread>
+
+#include "format.hpp"
+#include "series_record.hpp"
+#include "tcp_socket.hpp"
+#include "udp_socket.hpp"
+
+using namespace std::chrono_literals;
+
+std::optional<Exporter::Request> Exporter::parse_request(const std::string &args,
+                                                         const std::string &default_ip) {
+  std::vector<std::string> fields;
+  std::stringstream ss(args);
+  std::string field;
+  while (std::getline(ss, field, ',')) {
+    fields.push_back(field);
+  }
+  if (fields.size() < 3 || fields.size() > 5) {
+    return std::nullopt;
+  }
+  Request request;
+  if (fields[0] == "plots") {
+    request.content = Content::PLOTS;
+  } else if (fields[0] == "logs") {
+    request.content = Content::LOGS;
+  } else {
+    return std::nullopt;
+  }
+  if (fields[1] == "csv") {
+    request.format = Format::CSV;
+  } else if (fields[1] == "bin") {
+    request.format = Format::BINARY;
+  } else if (fields[1] == "text") {
+    request.format = Format::TEXT;
+  } else {
+    return std::nullopt;
+  }
+  // plots are samples, logs are text
+  if ((request.content == Content::LOGS) != (request.format == Format::TEXT)) {
+    return std::nullopt;
+  }
+  int port = std::atoi(fields[2].c_str());
+  if (port <= 0 || port > 65535) {
+    return std::nullopt;
+  }
+  request.port = port;
+  if (fields.size() > 3) {
+    if (fields[3] == "udp") {
+      request.transport = Transport::UDP;
+    } else if (fields[3] == "tcp") {
+      request.transport = Transport::TCP;
+    } else {
+      return std::nullopt;
+    }
+  }
+  request.ip = fields.size() > 4 ? fields[4] : default_ip;
+  if (request.ip.empty()) {
+    return std::nullopt;
+  }
+  return request;
+}
+
+bool Exporter::start(const Request &request) {
+  if (running_.exchange(true)) {
+    logger_.warn("An export is already running");
+    return false;
+  }
+  // the previous task (if any) has finished, so it can be replaced
+  task_ = espp::Task::make_unique(espp::Task::Config{
+      .callback = [this, request](auto &, auto &) -> bool {
+        run(request);
+        running_ = false;
+        // only run once
+        return true;
+      },
+      .task_config = {.name = "Exporter", .stack_size_bytes = 6 * 1024}});
+  task_->start();
+  return true;
+}
+
+void Exporter::run(const Request &request) {
+  logger_.info("Exporting {} to {}:{} over {}",
+               request.content == Content::PLOTS ? "plots" : "logs", request.ip, request.port,
+               request.transport == Transport::UDP ? "UDP" : "TCP");
+  std::unique_ptr<espp::UdpSocket> udp_socket;
+  std::unique_ptr<espp::TcpSocket> tcp_socket;
+  send_fn send;
+  if (request.transport == Transport::UDP) {
+    udp_socket = std::make_unique<espp::UdpSocket>(
+        espp::UdpSocket::Config{.log_level = espp::Logger::Verbosity::WARN});
+    espp::UdpSocket::SendConfig send_config{.ip_address = request.ip, .port = request.port};
+    send = [&udp_socket, send_config](std::string_view chunk) {
+      bool sent = udp_socket->send(chunk, send_config);
+      // give the network (and the requester) time to keep up, since nothing
+      // resends lost datagrams
+      std::this_thread::sleep_for(2ms);
+      return sent;
+    };
+  } else {
+    tcp_socket = std::make_unique<espp::TcpSocket>(
+        espp::TcpSocket::Config{.log_level = espp::Logger::Verbosity::WARN});
+    if (!tcp_socket->connect({.ip_address = request.ip, .port = request.port})) {
+      logger_.error("Could not connect to {}:{}", request.ip, request.port);
+      return;
+    }
+    send = [&tcp_socket](std::string_view chunk) { return tcp_socket->transmit(chunk); };
+  }
+
+  bool success = false;
+  switch (request.format) {
+  case Format::CSV:
+    success = send_csv(send);
+    break;
+  case Format::BINARY:
+    success = send_binary(send);
+    break;
+  case Format::TEXT:
+    success = send_logs(send);
+    break;
+  }
+  if (success && udp_socket) {
+    // mark the end of the export
+    success = send(std::string_view{});
+  }
+  if (!success) {
+    logger_.error("Export to {}:{} failed", request.ip, request.port);
+  } else {
+    logger_.info("Export to {}:{} done", request.ip, request.port);
+  }
+}
+
+bool Exporter::send_csv(const send_fn &send) {
+  std::string chunk = "series,index,value\n";
+  std::string line;
+  for (const auto &[name, samples] : config_.get_plot_samples()) {
+    for (size_t i = 0; i < samples.size(); i++) {
+      line = fmt::format("{},{},{}\n", name, i, samples[i]);
+      if (chunk.size() + line.size() > config_.chunk_size && !chunk.empty()) {
+        if (!send(chunk)) {
+          return false;
+        }
+        chunk.clear();
+      }
+      chunk += line;
+    }
+  }
+  return chunk.empty() || send(chunk);
+}
+
+bool Exporter::send_binary(const send_fn &send) {
+  std::vector<uint8_t> chunk(config_.chunk_size);
+  size_t chunk_size = 0;
+  for (const auto &[name, samples] : config_.get_plot_samples()) {
+    size_t num_written = 0;
+    while (true) {
+      size_t record_size;
+      size_t count =
+          SeriesRecord::serialize(name, samples.data() + num_written, samples.size() - num_written,
+                                  chunk.data() + chunk_size, chunk.size() - chunk_size, record_size);
+      bool is_complete = num_written + count == samples.size();
+      if (record_size > 0 && (count > 0 || is_complete)) {
+        chunk_size += record_size;
+        num_written += count;
+        if (is_complete) {
+          break;
+        }
+      } else if (chunk_size == 0) {
+        // the name alone doesn't fit into a chunk
+        logger_.warn("Skipping series '{}', its name is too long", name);
+        break;
+      }
+      // the chunk is full, so send it and continue in the next one
+      if (!send({reinterpret_cast<const char *>(chunk.data()), chunk_size})) {
+        return false;
+      }
+      chunk_size = 0;
+    }
+  }
+  return chunk_size == 0 || send({reinterpret_cast<const char *>(chunk.data()), chunk_size});
+}
+
+bool Exporter::send_logs(const send_fn &send) {
+  size_t offset = 0;
+  while (true) {
+    // read a chunk at a time, so that the gui is never blocked for long
+    auto chunk = config_.get_logs(offset, config_.chunk_size);
+    if (chunk.empty()) {
+      return true;
+    }
+    if (!send(chunk)) {
+      return false;
+    }
+    offset += chunk.size();
+  }
+}
@@ -1,9 +1,13 @@
 #pragma once
 
+#include <chrono>
 #include <cstring>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "series_stats.hpp"
 #include "window.hpp"
 
 class GraphWindow : public Window {
@@ -18,6 +22,11 @@ public:
   void add_data(const std::string &plot_name, int new_data);
   void remove_plot(const std::string &plot_name);
 
+  std::vector<std::pair<std::string, SeriesStats>> get_stats() const;
+  std::vector<std::pair<std::string, std::vector<int32_t>>> get_samples() const;
+
+  bool empty() const { return plot_map_.empty(); }
+
   lv_obj_t *get_lv_obj(void) { return wrapper_; }
 
   void invalidate() {
@@ -27,15 +36,30 @@ public:
   }
 
 protected:
-  lv_chart_series_t *create_plot(const std::string &plotName);
-  lv_chart_series_t *get_plot(const std::string &plotName);
+  struct Plot {
+    lv_chart_series_t *series{nullptr}; ///< Chart series holding the visible points
+    lv_span_t *legend{nullptr};         ///< Legend entry for this plot
+    SeriesStats stats{};                ///< Running statistics of all data received
+    bool stats_changed{false};          ///< Whether the legend needs to be updated
+    float legend_rate{0};               ///< Rate shown in the legend, which decays when quiet
+  };
+
+  static constexpr auto legend_update_period = std::chrono::milliseconds(250);
+
+  Plot &create_plot(const std::string &plotName);
+  Plot *get_plot(const std::string &plotName);
 
   void update_ticks(void);
+  void update_legend(void);
 
 private:
   lv_obj_t *wrapper_{nullptr};
   lv_obj_t *y_scale_{nullptr};
   lv_obj_t *chart_{nullptr};
   lv_obj_t *legend_{nullptr};
-  std::unordered_map<std::string, lv_chart_series_t *> plot_map_{};
+  std::unordered_map<std::string, Plot> plot_map_{};
+  bool needs_update_{false}; ///< Whether the data changed since the last update
+  std::chrono::steady_clock::time_point legend_updated_{};
+  int32_t y_min_{0};         ///< Current lower bound of the y axis
+  int32_t y_max_{0};         ///< Current upper bound of the y axis
 };
@@ -1,15 +1,19 @@
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <queue>
 #include <sstream>
+#include <unordered_map>
 
 #include <sdkconfig.h>
 
 #include "converter.hpp"
 #include "display.hpp"
 #include "graph_window.hpp"
+#include "histogram_window.hpp"
+#include "latency.hpp"
 #include "logger.hpp"
 #include "task.hpp"
 #include "text_window.hpp"
@@ -20,19 +24,42 @@ public:
   using Display = espp::Display<Pixel>;
 
   const std::string delimeter_data = "::"; ///< Delimeter indicating this contains plottable data
+  const std::string delimeter_group = "/";  ///< Delimeter separating a plot's group from its name
   const std::string delimeter_command = "+++";   ///< Delimeter indicating this contains a command
   const std::string command_remove_plot = "RP:"; ///< Command: remove plot
   const std::string command_clear_plots = "CP";  ///< Command: clear plots
   const std::string command_clear_logs = "CL";   ///< Command: clear logs
+  const std::string command_plot_type = "PT:";   ///< Command: set plot type
+  const std::string command_point_count = "PC:"; ///< Command: set chart point count
+  const std::string command_export = "EX:";      ///< Command: export plots or logs
+  const std::string command_mirror = "MR:";      ///< Command: mirror the screen
+
+  /// Data waiting to be parsed, and where it came from.
+  struct Packet {
+    std::string data;
+    std::string sender{""};        ///< Address of the sender, empty if not from the network
+    LatencyTracker::Trace trace{}; ///< When the packet was sent, received and queued
+  };
+
+  /// Called (from the gui task) with the arguments of a command which is
+  /// handled outside of the gui, and the sender of the packet which contained it.
+  typedef std::function<void(const std::string &args, const std::string &sender)> command_fn;
 
   struct Config {
     std::shared_ptr<Display> display; ///< Display to use
     size_t max_chart_point_count{30}; ///< Max number of points to show on the chart
+    size_t max_data_queue_size{16};   ///< Max number of received packets waiting to be parsed
+    command_fn on_export{nullptr};    ///< Handles export commands, which are ignored if null
+    command_fn on_mirror{nullptr};    ///< Handles mirror commands, which are ignored if null
     espp::Logger::Verbosity log_level{espp::Logger::Verbosity::WARN}; ///< Log level
   };
 
   explicit Gui(const Config &config)
-      : display_(config.display)
+      : max_chart_point_count_(config.max_chart_point_count)
+      , max_data_queue_size_(config.max_data_queue_size)
+      , on_export_(config.on_export)
+      , on_mirror_(config.on_mirror)
+      , display_(config.display)
       , logger_({.tag = "Gui", .level = config.log_level}) {
     init_ui();
     plot_window_.set_max_point_count(config.max_chart_point_count);
@@ -55,29 +82,70 @@ public:
   void clear_plots();
   void clear_logs();
 
-  void push_data(const std::string &data);
-  std::string pop_data();
+  /// Queue data to be parsed by the gui task, returning false (and dropping
+  /// it) if the queue is full. The trace's received time defaults to now.
+  bool push_data(const std::string &data, const std::string &sender = "",
+                 const LatencyTracker::Trace &trace = {});
+  Packet pop_data();
+  size_t get_data_queue_size();
+  size_t get_data_queue_capacity() const { return max_data_queue_size_; }
 
   void clear_info();
   void add_info(const std::string &info);
 
+  /// Parse the next queued packet. The windows are only redrawn by the gui
+  /// task, once per frame.
   bool handle_data();
 
   void set_chart_max_point_count(size_t count) { plot_window_.set_max_point_count(count); }
+  void set_chart_max_point_count(const std::string &group, size_t count);
+
+  void set_plot_type(const std::string &plot_name, const HistogramWindow::Config &config);
+  void set_line_plot_type(const std::string &plot_name);
+
+  std::vector<std::pair<std::string, SeriesStats>> get_plot_stats();
+  std::vector<std::pair<std::string, std::vector<int32_t>>> get_plot_samples();
+  std::string get_logs(size_t offset, size_t max_size);
+
+  /// Latency of the packets from when they were sent to when they were shown.
+  LatencyTracker get_latency();
+  void reset_latency();
 
 protected:
   void init_ui();
   void deinit_ui();
 
+  void remove_tab(lv_obj_t *tab);
+
+  GraphWindow &get_graph_window(const std::string &group);
+  std::pair<std::string, std::string> split_plot_name(const std::string &plot_name) const;
+
+  void add_plot_data(const std::string &plot_name, int value);
+  void remove_plot(const std::string &plot_name);
+  void remove_line_plot(const std::string &plot_name);
+  bool parse_plot_type(const std::string &args);
+  bool parse_point_count(const std::string &args);
+  void update_windows();
+
   bool update(std::mutex &m, std::condition_variable &cv) {
+    bool has_more_data = false;
     {
       std::lock_guard<std::recursive_mutex> lk(mutex_);
+      // parse the data which was queued before this frame; anything arriving
+      // meanwhile waits for the next one, so that the display keeps refreshing
+      for (size_t count = get_data_queue_size(); count > 0; count--) {
+        handle_data();
+      }
+      has_more_data = get_data_queue_size() > 0;
+      // redraw once for all of the data parsed above
+      update_windows();
       lv_task_handler();
     }
     {
       using namespace std::chrono_literals;
       std::unique_lock<std::mutex> lk(m);
-      cv.wait_for(lk, 16ms);
+      // come back quickly if data is waiting, but still let other tasks run
+      cv.wait_for(lk, has_more_data ? 1ms : 16ms);
     }
     // don't want to stop the task
     return false;
@@ -103,6 +171,10 @@ protected:
       break;
     case LV_EVENT_KEY:
       break;
+    case LV_EVENT_REFR_READY:
+      // the data parsed before this frame is now on screen
+      gui->latency_.on_rendered(LatencyTracker::Clock::now());
+      break;
     default:
       break;
     }
@@ -110,13 +182,22 @@ protected:
 
   void on_pressed(lv_event_t *e);
 
+  size_t max_chart_point_count_;
+  size_t max_data_queue_size_;
+  command_fn on_export_;
+  command_fn on_mirror_;
   GraphWindow plot_window_;
+  std::unordered_map<std::string, std::unique_ptr<GraphWindow>> group_windows_;
+  std::unordered_map<std::string, size_t> group_point_counts_; ///< Set by command, kept on clear
   TextWindow log_window_;
   TextWindow info_window_;
+  std::unordered_map<std::string, std::unique_ptr<HistogramWindow>> histogram_windows_;
   lv_obj_t *tabview_;
+  lv_display_t *lv_display_{nullptr};
+  LatencyTracker latency_;
 
   std::mutex data_queue_mutex_;
-  std::queue<std::string> data_queue_;
+  std::queue<Packet> data_queue_;
 
   std::shared_ptr<Display> display_;
   std::unique_ptr<espp::Task> task_;
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// Fixed-size histogram with an optional history of columns, used for both
+/// the histogram and the (time-vs-value) heatmap plot types. All storage is
+/// allocated by configure(), so binning a sample is O(1) and never allocates.
+///
+/// If no range is given, the histogram ranges itself automatically: the range
+/// starts out around the first sample and doubles (merging pairs of adjacent
+/// bins) whenever a sample falls outside of it.
+class Histogram {
+public:
+  Histogram() = default;
+
+  void configure(size_t bin_count, size_t column_count = 1, float min = 0, float max = 0);
+  void clear();
+
+  void add(float value);
+  void advance();
+
+  size_t bin_count() const { return bin_count_; }
+  size_t column_count() const { return column_count_; }
+  bool auto_range() const { return auto_range_; }
+  float min() const { return min_; }
+  float max() const { return max_; }
+
+  /// Count of a bin. Column 0 is the oldest column, column_count() - 1 the
+  /// current one.
+  uint32_t count(size_t bin, size_t column) const;
+  uint32_t count(size_t bin) const { return count(bin, column_count_ - 1); }
+  uint32_t max_count() const { return max_count_; }
+  size_t total() const { return total_; }
+
+  /// Range of bins of the current column that changed since the last call to
+  /// clear_changes(). Only valid if has_changes() is true.
+  size_t first_changed_bin() const { return first_changed_; }
+  size_t last_changed_bin() const { return last_changed_; }
+  bool has_changes() const { return first_changed_ <= last_changed_; }
+  /// Whether every bin of every column must be redrawn, e.g. because the
+  /// range changed or the columns were shifted.
+  bool all_changed() const { return all_changed_; }
+  void clear_changes();
+
+protected:
+  void expand_range(float value);
+  void mark_changed(size_t bin);
+  void mark_all_changed();
+
+  size_t bin_count_{0};
+  size_t column_count_{0};
+  size_t current_{0}; ///< Index of the current column in the ring of columns
+  bool auto_range_{true};
+  bool has_range_{false};
+  float min_{0};
+  float max_{0};
+  float bin_width_{0};
+  std::vector<uint32_t> counts_{}; ///< column_count_ columns of bin_count_ bins
+  uint32_t max_count_{0};
+  size_t total_{0};
+
+  size_t first_changed_{SIZE_MAX};
+  size_t last_changed_{0};
+  bool all_changed_{false};
+};
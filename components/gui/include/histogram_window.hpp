@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "histogram.hpp"
+#include "series_stats.hpp"
+#include "window.hpp"
+
+/// Shows the distribution of a single series, either as a histogram of all
+/// the samples received or as a scrolling (time-vs-value) heatmap.
+class HistogramWindow : public Window {
+public:
+  enum class Type { HISTOGRAM, HEATMAP };
+
+  struct Config {
+    Type type{Type::HISTOGRAM}; ///< How to show the distribution
+    size_t bin_count{32};       ///< Number of bins to sort the samples into
+    float min{0};               ///< Lower bound of the bins (auto-ranged if min >= max)
+    float max{0};               ///< Upper bound of the bins (auto-ranged if min >= max)
+  };
+
+  static constexpr size_t max_bin_count = 128; ///< Limit on the number of bins (and bars)
+
+  HistogramWindow() = default;
+  ~HistogramWindow();
+
+  void init(lv_obj_t *parent, size_t width, size_t height) override;
+  void update() override;
+  void clear() override;
+  void configure(const std::string &name, const Config &config);
+
+  void add_data(int new_data);
+
+  const SeriesStats &get_stats() const { return stats_; }
+
+  lv_obj_t *get_lv_obj(void) { return wrapper_; }
+
+  void invalidate() {
+    if (wrapper_) {
+      lv_obj_invalidate(wrapper_);
+    }
+  }
+
+protected:
+  static constexpr size_t heatmap_column_count = 60;
+  static constexpr auto heatmap_column_period = std::chrono::milliseconds(250);
+  static constexpr auto title_update_period = std::chrono::milliseconds(250);
+
+  void create_bars();
+  void create_heatmap();
+  void delete_plot();
+
+  void update_title();
+  void update_bars(bool redraw_all);
+  void update_heatmap(bool redraw_all);
+  void draw_heatmap_column(size_t column, size_t first_bin, size_t last_bin);
+
+  uint32_t get_scale() const;
+
+private:
+  std::string name_{""};
+  Config config_{};
+  Histogram histogram_{};
+  SeriesStats stats_{};
+  bool stats_changed_{false};
+  uint32_t scale_{0}; ///< Count which fills the plot area, a power of two
+
+  lv_obj_t *wrapper_{nullptr};
+  lv_obj_t *title_{nullptr};
+  lv_obj_t *plot_area_{nullptr};
+  std::vector<lv_obj_t *> bars_{};
+  std::vector<int32_t> bar_heights_{};
+  lv_obj_t *canvas_{nullptr};
+  lv_draw_buf_t *canvas_buf_{nullptr};
+  std::array<uint16_t, 32> palette_{};
+
+  std::chrono::steady_clock::time_point column_start_{};
+  std::chrono::steady_clock::time_point title_updated_{};
+};
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// Histogram of latencies with fixed (roughly logarithmic) buckets, so that it
+/// needs constant memory and time per sample. Percentiles are interpolated
+/// within their bucket, while the min, max and mean are exact.
+class LatencyHistogram {
+public:
+  /// Upper bounds (in microseconds) of the buckets; the last bucket is unbounded.
+  static constexpr std::array<int64_t, 15> bucket_bounds_us = {
+      100,    200,    500,    1000,    2000,    5000,    10000,  20000,
+      50000, 100000, 200000, 500000, 1000000, 2000000, 5000000};
+  static constexpr size_t bucket_count = bucket_bounds_us.size() + 1;
+
+  void add(int64_t latency_us);
+  void reset();
+
+  size_t count() const { return count_; }
+  size_t bucket(size_t index) const { return buckets_[index]; }
+  int64_t min_us() const { return min_us_; }
+  int64_t max_us() const { return max_us_; }
+  float mean_us() const { return count_ ? static_cast<float>(sum_us_) / count_ : 0; }
+  float percentile_us(float percentile) const;
+
+  std::string to_string() const;
+
+protected:
+  std::array<uint32_t, bucket_count> buckets_{};
+  size_t count_{0};
+  int64_t sum_us_{0};
+  int64_t min_us_{0};
+  int64_t max_us_{0};
+};
+
+/// Estimates the offset between a sender's clock and ours, as the minimum of
+/// (receive time - send time) over a sliding window. This includes the
+/// smallest network delay in the window, so latencies measured with it are
+/// relative to the fastest packet; the window lets it follow clock drift.
+class ClockOffset {
+public:
+  void add(int64_t local_us, int64_t remote_us);
+
+  /// Offset of our clock from the sender's (local - remote) in microseconds.
+  std::optional<int64_t> offset_us() const;
+
+protected:
+  static constexpr int64_t window_us = 10 * 1000 * 1000;
+
+  int64_t window_start_us_{0};
+  std::optional<int64_t> current_min_{};  ///< Minimum in the current window
+  std::optional<int64_t> previous_min_{}; ///< Minimum in the previous window
+};
+
+/// Traces the latency of received packets through each stage of the display,
+/// from the sender's timestamp (if it sent one) to the frame which showed
+/// their data.
+class LatencyTracker {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  enum Stage {
+    NETWORK,    ///< Sender timestamp to received (needs a sender timestamp)
+    RECEIVE,    ///< Received to queued (decoding / decompressing)
+    QUEUE,      ///< Waiting in the queue for the gui task
+    PARSE,      ///< Parsing the data into the widgets (but not redrawing them)
+    RENDER,     ///< Parsed to the end of the frame, incl. updating the windows and drawing
+    TOTAL,      ///< Received to rendered
+    END_TO_END, ///< Sender timestamp to rendered (needs a sender timestamp)
+    STAGE_COUNT,
+  };
+
+  /// Timestamps of a packet, as it moves through the display.
+  struct Trace {
+    Clock::time_point received{};
+    Clock::time_point queued{};
+    std::optional<uint64_t> sender_time_us{}; ///< Sender's timestamp, in its own clock
+  };
+
+  static const char *stage_name(Stage stage);
+
+  /// Record a packet which was parsed, whose data is shown in the next frame.
+  void on_parsed(const std::string &sender, const Trace &trace, Clock::time_point popped,
+                 Clock::time_point parsed);
+  /// Record that a frame was rendered.
+  void on_rendered(Clock::time_point rendered);
+
+  void reset();
+
+  const LatencyHistogram &get(Stage stage) const { return histograms_[stage]; }
+  /// Estimated offset of our clock from each sender's (local - remote) in microseconds.
+  std::vector<std::pair<std::string, int64_t>> get_clock_offsets_us() const;
+  /// Packets whose render was not traced, because too many were waiting to be rendered.
+  size_t num_untracked() const { return num_untracked_; }
+
+protected:
+  static constexpr size_t max_pending = 64; ///< Packets waiting to be rendered
+  static constexpr size_t max_senders = 8;  ///< Senders to estimate clock offsets for
+
+  struct Pending {
+    Clock::time_point received;
+    Clock::time_point parsed;
+    std::optional<int64_t> sent; ///< Sender timestamp, in our clock (microseconds)
+  };
+
+  static int64_t to_us(Clock::time_point time);
+  void add(Stage stage, int64_t latency_us) { histograms_[stage].add(latency_us); }
+
+  std::array<LatencyHistogram, STAGE_COUNT> histograms_{};
+  std::unordered_map<std::string, ClockOffset> clock_offsets_{};
+  std::vector<Pending> pending_{};
+  size_t num_untracked_{0}; ///< Packets not traced because too many were pending
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+/// Streaming quantile estimator using the P-Square algorithm (Jain &
+/// Chlamtac, 1985). Tracks a single quantile with five markers, so it needs
+/// O(1) memory and O(1) time per sample, at the cost of being approximate.
+class P2Quantile {
+public:
+  explicit P2Quantile(float quantile);
+
+  void add(float value);
+  float value() const;
+  void reset();
+
+protected:
+  float parabolic(int i, float d) const;
+  float linear(int i, int d) const;
+
+  float quantile_;
+  size_t count_{0};
+  std::array<float, 5> heights_{};
+  std::array<float, 5> positions_{};
+  std::array<float, 5> desired_positions_{};
+  std::array<float, 5> increments_{};
+};
+
+/// Running statistics for a single data series. Every statistic is updated in
+/// O(1) time per sample and without storing the samples themselves.
+class SeriesStats {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  SeriesStats() = default;
+
+  void add(float value);
+  void reset();
+
+  size_t count() const { return count_; }
+  float last() const { return last_; }
+  float min() const { return min_; }
+  float max() const { return max_; }
+  float mean() const { return mean_; }
+  float stddev() const;
+  float p50() const { return p50_.value(); }
+  float p99() const { return p99_.value(); }
+  float rate() const;
+
+  std::string to_string() const;
+
+protected:
+  static constexpr auto rate_window = std::chrono::seconds(1); ///< Sample rate averaging window
+
+  size_t count_{0};
+  float last_{0};
+  float min_{0};
+  float max_{0};
+  float mean_{0};
+  float m2_{0}; ///< Sum of squared differences from the mean (Welford)
+  P2Quantile p50_{0.50f};
+  P2Quantile p99_{0.99f};
+
+  Clock::time_point window_start_{};
+  size_t window_count_{0};
+  float rate_{0}; ///< Samples per second over the last complete window
+};
@@ -14,6 +14,11 @@ public:
   void clear_logs(void);
   void add_log(const std::string &log_text);
 
+  /// Up to max_size bytes of the logs, starting at offset.
+  std::string get_logs(size_t offset, size_t max_size) const {
+    return offset < log_text_.size() ? log_text_.substr(offset, max_size) : "";
+  }
+
   lv_obj_t *get_lv_obj(void) { return log_container_; }
 
   void invalidate() {
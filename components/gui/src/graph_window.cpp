@@ -1,5 +1,8 @@
 #include "graph_window.hpp"
 
+#include <algorithm>
+#include <climits>
+
 #include "format.hpp"
 
 #include <widgets/chart/lv_chart_private.h>
@@ -67,6 +70,7 @@ void GraphWindow::init(lv_obj_t *parent, size_t width, size_t height) {
 void GraphWindow::set_max_point_count(size_t max_point_count) {
   // set the maximum number of points to be displayed on the chart
   lv_chart_set_point_count(chart_, max_point_count);
+  needs_update_ = true;
 }
 
 void GraphWindow::update_ticks() {
@@ -75,31 +79,67 @@ void GraphWindow::update_ticks() {
     return;
   }
   // get the minimum and maximum
-  std::vector<lv_coord_t> y_points;
-
+  int32_t min = INT32_MAX;
+  int32_t max = INT32_MIN;
   auto num_points = lv_chart_get_point_count(chart_);
   for (const auto &e : plot_map_) {
-    auto series = e.second;
+    auto series = e.second.series;
     for (size_t i = 0; i < num_points; i++) {
       auto point = series->y_points[i];
       if (point == LV_CHART_POINT_NONE) {
         // skip this point
         continue;
       }
-      y_points.push_back(series->y_points[i]);
+      min = std::min(min, point);
+      max = std::max(max, point);
     }
   }
-
-  // get the min/max values
-  auto min = *std::min_element(y_points.begin(), y_points.end());
-  auto max = *std::max_element(y_points.begin(), y_points.end());
+  if (min > max) {
+    // no points yet
+    return;
+  }
+  if (min == y_min_ && max == y_max_) {
+    // the range didn't change, so there's nothing to redraw
+    return;
+  }
+  y_min_ = min;
+  y_max_ = max;
 
   // update the chart range
   lv_chart_set_range(chart_, LV_CHART_AXIS_PRIMARY_Y, min, max);
   lv_scale_set_range(y_scale_, min, max);
 }
 
+void GraphWindow::update_legend() {
+  bool changed = false;
+  for (auto &[name, plot] : plot_map_) {
+    // quiet series are still refreshed until their (decaying) rate shows as 0
+    if (!plot.stats_changed && plot.legend_rate < 0.05f) {
+      continue;
+    }
+    std::string legend_text = fmt::format("{} {}\n", name, plot.stats.to_string());
+    lv_span_set_text(plot.legend, legend_text.c_str());
+    plot.stats_changed = false;
+    plot.legend_rate = plot.stats.rate();
+    changed = true;
+  }
+  if (changed) {
+    lv_spangroup_refr_mode(legend_);
+  }
+}
+
 void GraphWindow::update() {
+  // the legend is re-laid out at a limited rate, like the histogram titles
+  auto now = std::chrono::steady_clock::now();
+  if (now - legend_updated_ >= legend_update_period) {
+    update_legend();
+    legend_updated_ = now;
+  }
+  if (!needs_update_) {
+    // nothing changed, so don't invalidate the chart
+    return;
+  }
+  needs_update_ = false;
   // make sure if we have new data we update the range & tick values
   update_ticks();
   // update the chart if we use our own data arrays or modify the data
@@ -109,8 +149,8 @@ void GraphWindow::update() {
 
 void GraphWindow::clear_plots(void) {
   // remove all the series from the chart
-  for (auto e : plot_map_) {
-    lv_chart_remove_series(chart_, e.second);
+  for (const auto &e : plot_map_) {
+    lv_chart_remove_series(chart_, e.second.series);
   }
   // now clear the map
   plot_map_.clear();
@@ -118,6 +158,7 @@ void GraphWindow::clear_plots(void) {
   while (lv_spangroup_get_child(legend_, 0)) {
     lv_spangroup_delete_span(legend_, lv_spangroup_get_child(legend_, 0));
   }
+  needs_update_ = true;
   // invalidate
   invalidate();
 }
@@ -126,19 +167,23 @@ void GraphWindow::add_data(const std::string &plotName, int newData) {
   auto plot = get_plot(plotName);
   // couldn't find the plot so create a new one
   if (plot == nullptr)
-    plot = create_plot(plotName);
+    plot = &create_plot(plotName);
   // now add the data
-  lv_chart_set_next_value(chart_, plot, newData);
+  lv_chart_set_next_value(chart_, plot->series, newData);
+  // and track it in the statistics, which are shown on the next update
+  plot->stats.add(newData);
+  plot->stats_changed = true;
+  needs_update_ = true;
 }
 
-lv_chart_series_t *GraphWindow::create_plot(const std::string &plotName) {
+GraphWindow::Plot &GraphWindow::create_plot(const std::string &plotName) {
   // make a random color
   uint8_t red = rand() % 256;
   uint8_t green = rand() % 256;
   uint8_t blue = rand() % 256;
   auto color = lv_color_make(red, green, blue);
   // now make the plot
-  auto plot = lv_chart_add_series(chart_, color, LV_CHART_AXIS_PRIMARY_Y);
+  auto series = lv_chart_add_series(chart_, color, LV_CHART_AXIS_PRIMARY_Y);
 
   // create a new span for the new legend text
   auto span = lv_spangroup_new_span(legend_);
@@ -149,9 +194,10 @@ lv_chart_series_t *GraphWindow::create_plot(const std::string &plotName) {
 
   lv_spangroup_refr_mode(legend_);
 
-  // add it to the map
-  plot_map_[plotName] = plot;
-  // and return it
+  // add it to the map and return it
+  auto &plot = plot_map_[plotName];
+  plot.series = series;
+  plot.legend = span;
   return plot;
 }
 
@@ -159,18 +205,50 @@ void GraphWindow::remove_plot(const std::string &plotName) {
   auto plot = get_plot(plotName);
   if (plot != nullptr) {
     // we should remove it from the display
-    lv_chart_remove_series(chart_, plot);
+    lv_chart_remove_series(chart_, plot->series);
+    // and from the legend
+    lv_spangroup_delete_span(legend_, plot->legend);
+    lv_spangroup_refr_mode(legend_);
     // and delete the value from the map
     plot_map_.erase(plotName);
+    needs_update_ = true;
   }
 }
 
-lv_chart_series_t *GraphWindow::get_plot(const std::string &plotName) {
-  lv_chart_series_t *plot = nullptr;
+GraphWindow::Plot *GraphWindow::get_plot(const std::string &plotName) {
+  Plot *plot = nullptr;
   auto search = plot_map_.find(plotName);
   if (search != plot_map_.end()) {
     // set the plot to be the value of the element
-    plot = search->second;
+    plot = &search->second;
   }
   return plot;
 }
+
+std::vector<std::pair<std::string, SeriesStats>> GraphWindow::get_stats() const {
+  std::vector<std::pair<std::string, SeriesStats>> stats;
+  stats.reserve(plot_map_.size());
+  for (const auto &[name, plot] : plot_map_) {
+    stats.emplace_back(name, plot.stats);
+  }
+  return stats;
+}
+
+std::vector<std::pair<std::string, std::vector<int32_t>>> GraphWindow::get_samples() const {
+  std::vector<std::pair<std::string, std::vector<int32_t>>> samples;
+  samples.reserve(plot_map_.size());
+  auto num_points = lv_chart_get_point_count(chart_);
+  for (const auto &[name, plot] : plot_map_) {
+    auto &values = samples.emplace_back(name, std::vector<int32_t>{}).second;
+    values.reserve(num_points);
+    // the chart shifts by overwriting its oldest point, so start from there
+    auto start = lv_chart_get_x_start_point(chart_, plot.series);
+    for (size_t i = 0; i < num_points; i++) {
+      auto point = plot.series->y_points[(start + i) % num_points];
+      if (point != LV_CHART_POINT_NONE) {
+        values.push_back(point);
+      }
+    }
+  }
+  return samples;
+}
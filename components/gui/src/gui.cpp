@@ -3,7 +3,10 @@
 using namespace espp;
 using namespace std::chrono_literals;
 
-void Gui::deinit_ui() { lv_obj_del(tabview_); }
+void Gui::deinit_ui() {
+  lv_display_remove_event_cb_with_user_data(lv_display_, &Gui::event_callback, this);
+  lv_obj_del(tabview_);
+}
 
 void Gui::init_ui() {
   // Initialize the GUI
@@ -28,12 +31,31 @@ void Gui::init_ui() {
   // lv_obj_set_scrollbar_mode(info_tab, LV_SCROLLBAR_MODE_OFF);
   info_window_.init(info_tab, display_->width(), display_->height());
 
+  // trace when the parsed data actually makes it to the screen
+  lv_display_ = lv_obj_get_display(tabview_);
+  lv_display_add_event_cb(lv_display_, &Gui::event_callback, LV_EVENT_REFR_READY,
+                          static_cast<void *>(this));
+
   // rom screen navigation
   // lv_obj_add_event_cb(ui_settingsbutton, &Gui::event_callback, LV_EVENT_PRESSED,
   // static_cast<void*>(this)); lv_obj_add_event_cb(ui_playbutton, &Gui::event_callback,
   // LV_EVENT_PRESSED, static_cast<void*>(this));
 }
 
+void Gui::remove_tab(lv_obj_t *tab) {
+  // the tabs and their buttons in the tab bar share the same index
+  auto index = lv_obj_get_index(tab);
+  auto active_tab = lv_tabview_get_tab_act(tabview_);
+  lv_obj_del(lv_obj_get_child(lv_tabview_get_tab_bar(tabview_), index));
+  lv_obj_del(tab);
+  // keep the same tab active, or fall back to the first one if we removed it
+  if (active_tab == index) {
+    lv_tabview_set_act(tabview_, 0, LV_ANIM_OFF);
+  } else if (active_tab > index) {
+    lv_tabview_set_act(tabview_, active_tab - 1, LV_ANIM_OFF);
+  }
+}
+
 void Gui::switch_tab() {
   std::lock_guard<std::recursive_mutex> lk{mutex_};
   auto num_tabs = lv_tabview_get_tab_count(tabview_);
@@ -42,19 +64,35 @@ void Gui::switch_tab() {
   lv_tabview_set_act(tabview_, next_tab, LV_ANIM_ON);
 }
 
-void Gui::push_data(const std::string &data) {
+bool Gui::push_data(const std::string &data, const std::string &sender,
+                    const LatencyTracker::Trace &trace) {
+  auto now = LatencyTracker::Clock::now();
   std::unique_lock<std::mutex> lock{data_queue_mutex_};
-  data_queue_.push(data);
+  if (data_queue_.size() >= max_data_queue_size_) {
+    return false;
+  }
+  Packet packet{data, sender, trace};
+  if (packet.trace.received == LatencyTracker::Clock::time_point{}) {
+    packet.trace.received = now;
+  }
+  packet.trace.queued = now;
+  data_queue_.push(std::move(packet));
+  return true;
 }
 
-std::string Gui::pop_data() {
+Gui::Packet Gui::pop_data() {
   std::unique_lock<std::mutex> lock{data_queue_mutex_};
-  std::string data{""};
+  Packet packet;
   if (!data_queue_.empty()) {
-    data = data_queue_.front();
+    packet = std::move(data_queue_.front());
     data_queue_.pop();
   }
-  return data;
+  return packet;
+}
+
+size_t Gui::get_data_queue_size() {
+  std::unique_lock<std::mutex> lock{data_queue_mutex_};
+  return data_queue_.size();
 }
 
 void Gui::clear_info() {
@@ -65,6 +103,171 @@ void Gui::clear_info() {
 void Gui::clear_plots() {
   std::lock_guard<std::recursive_mutex> lk{mutex_};
   plot_window_.clear_plots();
+  // the groups only exist to hold their plots, so remove them entirely
+  for (auto &[group, window] : group_windows_) {
+    remove_tab(lv_obj_get_parent(window->get_lv_obj()));
+  }
+  group_windows_.clear();
+  // histograms keep their configuration, but lose their data
+  for (auto &[name, window] : histogram_windows_) {
+    window->clear();
+  }
+}
+
+void Gui::set_plot_type(const std::string &plot_name, const HistogramWindow::Config &config) {
+  std::lock_guard<std::recursive_mutex> lk{mutex_};
+  auto &window = histogram_windows_[plot_name];
+  if (!window) {
+    // move the plot out of its chart and into its own tab
+    remove_line_plot(plot_name);
+    auto tab = lv_tabview_add_tab(tabview_, plot_name.c_str());
+    window = std::make_unique<HistogramWindow>();
+    window->init(tab, display_->width(), display_->height());
+  }
+  window->configure(plot_name, config);
+}
+
+void Gui::set_line_plot_type(const std::string &plot_name) {
+  std::lock_guard<std::recursive_mutex> lk{mutex_};
+  auto search = histogram_windows_.find(plot_name);
+  if (search == histogram_windows_.end()) {
+    // already a line plot
+    return;
+  }
+  remove_tab(lv_obj_get_parent(search->second->get_lv_obj()));
+  histogram_windows_.erase(search);
+}
+
+GraphWindow &Gui::get_graph_window(const std::string &group) {
+  if (group.empty()) {
+    return plot_window_;
+  }
+  auto &window = group_windows_[group];
+  if (!window) {
+    // each group gets its own chart, with its own range and point count
+    auto tab = lv_tabview_add_tab(tabview_, group.c_str());
+    window = std::make_unique<GraphWindow>();
+    window->init(tab, display_->width(), display_->height());
+    auto point_count = group_point_counts_.find(group);
+    window->set_max_point_count(point_count != group_point_counts_.end() ? point_count->second
+                                                                         : max_chart_point_count_);
+    window->clear_plots();
+  }
+  return *window;
+}
+
+std::pair<std::string, std::string> Gui::split_plot_name(const std::string &plot_name) const {
+  // "<group>/<name>" plots are shown in their group's chart, all others are
+  // shown in the default chart
+  auto pos = plot_name.find(delimeter_group);
+  if (pos == std::string::npos || pos == 0) {
+    return {"", plot_name};
+  }
+  return {plot_name.substr(0, pos), plot_name.substr(pos + delimeter_group.length())};
+}
+
+void Gui::set_chart_max_point_count(const std::string &group, size_t count) {
+  std::lock_guard<std::recursive_mutex> lk{mutex_};
+  if (group.empty()) {
+    plot_window_.set_max_point_count(count);
+    return;
+  }
+  // remembered across clearing the plots, and applied once the group has data
+  group_point_counts_[group] = count;
+  if (auto search = group_windows_.find(group); search != group_windows_.end()) {
+    search->second->set_max_point_count(count);
+  }
+}
+
+void Gui::add_plot_data(const std::string &plot_name, int value) {
+  auto search = histogram_windows_.find(plot_name);
+  if (search != histogram_windows_.end()) {
+    search->second->add_data(value);
+  } else {
+    auto [group, name] = split_plot_name(plot_name);
+    get_graph_window(group).add_data(name, value);
+  }
+}
+
+void Gui::remove_line_plot(const std::string &plot_name) {
+  auto [group, name] = split_plot_name(plot_name);
+  if (group.empty()) {
+    plot_window_.remove_plot(name);
+  } else if (auto search = group_windows_.find(group); search != group_windows_.end()) {
+    search->second->remove_plot(name);
+  }
+}
+
+void Gui::remove_plot(const std::string &plot_name) {
+  remove_line_plot(plot_name);
+  set_line_plot_type(plot_name);
+}
+
+bool Gui::parse_point_count(const std::string &args) {
+  // [<group>,]<point count>
+  std::string group{""};
+  std::string count_str = args;
+  auto pos = args.rfind(',');
+  if (pos != std::string::npos) {
+    group = args.substr(0, pos);
+    count_str = args.substr(pos + 1);
+  }
+  int count;
+  if (Converter::str2int(count, count_str.c_str()) != Converter::Status::Success || count <= 0) {
+    return false;
+  }
+  set_chart_max_point_count(group, count);
+  return true;
+}
+
+bool Gui::parse_plot_type(const std::string &args) {
+  // <plot name>,<line|hist|heat>[,<bin count>[,<min>,<max>]]
+  std::vector<std::string> fields;
+  std::stringstream ss(args);
+  std::string field;
+  while (std::getline(ss, field, ',')) {
+    fields.push_back(field);
+  }
+  if (fields.size() < 2) {
+    return false;
+  }
+  const auto &plot_name = fields[0];
+  const auto &type = fields[1];
+  if (type == "line") {
+    set_line_plot_type(plot_name);
+    return true;
+  }
+  HistogramWindow::Config config;
+  if (type == "hist") {
+    config.type = HistogramWindow::Type::HISTOGRAM;
+  } else if (type == "heat") {
+    config.type = HistogramWindow::Type::HEATMAP;
+  } else {
+    return false;
+  }
+  if (fields.size() == 4) {
+    // the range needs both a min and a max
+    return false;
+  }
+  if (fields.size() > 2) {
+    int bin_count;
+    if (Converter::str2int(bin_count, fields[2].c_str()) != Converter::Status::Success ||
+        bin_count <= 0) {
+      return false;
+    }
+    config.bin_count = bin_count;
+  }
+  if (fields.size() > 4) {
+    int min, max;
+    if (Converter::str2int(min, fields[3].c_str()) != Converter::Status::Success ||
+        Converter::str2int(max, fields[4].c_str()) != Converter::Status::Success) {
+      return false;
+    }
+    config.min = min;
+    config.max = max;
+  }
+  set_plot_type(plot_name, config);
+  return true;
 }
 
 void Gui::clear_logs() {
@@ -72,6 +275,46 @@ void Gui::clear_logs() {
   log_window_.clear_logs();
 }
 
+std::vector<std::pair<std::string, SeriesStats>> Gui::get_plot_stats() {
+  std::lock_guard<std::recursive_mutex> lk{mutex_};
+  auto stats = plot_window_.get_stats();
+  for (const auto &[group, window] : group_windows_) {
+    for (auto &[name, series_stats] : window->get_stats()) {
+      stats.emplace_back(group + delimeter_group + name, series_stats);
+    }
+  }
+  for (const auto &[name, window] : histogram_windows_) {
+    stats.emplace_back(name, window->get_stats());
+  }
+  return stats;
+}
+
+std::vector<std::pair<std::string, std::vector<int32_t>>> Gui::get_plot_samples() {
+  std::lock_guard<std::recursive_mutex> lk{mutex_};
+  auto samples = plot_window_.get_samples();
+  for (const auto &[group, window] : group_windows_) {
+    for (auto &[name, values] : window->get_samples()) {
+      samples.emplace_back(group + delimeter_group + name, std::move(values));
+    }
+  }
+  return samples;
+}
+
+std::string Gui::get_logs(size_t offset, size_t max_size) {
+  std::lock_guard<std::recursive_mutex> lk{mutex_};
+  return log_window_.get_logs(offset, max_size);
+}
+
+LatencyTracker Gui::get_latency() {
+  std::lock_guard<std::recursive_mutex> lk{mutex_};
+  return latency_;
+}
+
+void Gui::reset_latency() {
+  std::lock_guard<std::recursive_mutex> lk{mutex_};
+  latency_.reset();
+}
+
 void Gui::add_info(const std::string &info) {
   std::lock_guard<std::recursive_mutex> lk{mutex_};
   info_window_.add_log(info);
@@ -84,7 +327,9 @@ bool Gui::handle_data() {
   bool hasNewPlotData = false;
   bool hasNewTextData = false;
 
-  std::string newData = pop_data();
+  auto popped = LatencyTracker::Clock::now();
+  auto packet = pop_data();
+  const std::string &newData = packet.data;
   int len = newData.length();
   if (len > 0) {
     size_t num_lines = 0;
@@ -104,12 +349,32 @@ bool Gui::handle_data() {
           // make sure we transition to the next state
           hasNewTextData = true;
         } else if (command == command_clear_plots) {
-          plot_window_.clear_plots();
+          clear_plots();
+          // make sure we transition to the next state
+          hasNewPlotData = true;
+        } else if (command.rfind(command_plot_type, 0) == 0) {
+          if (!parse_plot_type(command.substr(command_plot_type.length()))) {
+            logger_.warn("invalid plot type command '{}'", line);
+          }
+          // make sure we transition to the next state
+          hasNewPlotData = true;
+        } else if (command.rfind(command_point_count, 0) == 0) {
+          if (!parse_point_count(command.substr(command_point_count.length()))) {
+            logger_.warn("invalid point count command '{}'", line);
+          }
           // make sure we transition to the next state
           hasNewPlotData = true;
+        } else if (command.rfind(command_export, 0) == 0) {
+          if (on_export_) {
+            on_export_(command.substr(command_export.length()), packet.sender);
+          }
+        } else if (command.rfind(command_mirror, 0) == 0) {
+          if (on_mirror_) {
+            on_mirror_(command.substr(command_mirror.length()), packet.sender);
+          }
         } else if ((pos = line.find(command_remove_plot)) != std::string::npos) {
           std::string plotName = line.substr(pos + command_remove_plot.length(), line.length());
-          plot_window_.remove_plot(plotName);
+          remove_plot(plotName);
           // make sure we transition to the next state
           hasNewPlotData = true;
         }
@@ -125,7 +390,7 @@ bool Gui::handle_data() {
             auto value = line.substr(pos, line.length());
             if (Converter::str2int(iValue, value.c_str()) == Converter::Status::Success) {
               // make sure we transition to the next state
-              plot_window_.add_data(plotName, iValue);
+              add_plot_data(plotName, iValue);
               hasNewPlotData = true;
             } else {
               logger_.warn("has '::', but could not convert to number, adding log '{}'", line);
@@ -150,12 +415,25 @@ bool Gui::handle_data() {
     }
     // logger_.info("parsed {} lines", num_lines);
   }
-  if (hasNewPlotData) {
-    plot_window_.update();
+  if (len > 0) {
+    latency_.on_parsed(packet.sender, packet.trace, popped, LatencyTracker::Clock::now());
   }
   return hasNewPlotData || hasNewTextData;
 }
 
+void Gui::update_windows() {
+  // histograms are binned and charts are filled as the data arrives, but only
+  // redrawn here; only the charts which received data are re-ranged, and the
+  // legends are refreshed periodically, even once their series go quiet
+  for (auto &[name, window] : histogram_windows_) {
+    window->update();
+  }
+  plot_window_.update();
+  for (auto &[group, window] : group_windows_) {
+    window->update();
+  }
+}
+
 void Gui::on_pressed(lv_event_t *e) {
   lv_obj_t *target = (lv_obj_t *)lv_event_get_target(e);
   logger_.info("PRESSED: {}", fmt::ptr(target));
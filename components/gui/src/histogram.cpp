@@ -0,0 +1,112 @@
+#include "histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void Histogram::configure(size_t bin_count, size_t column_count, float min, float max) {
+  // auto ranging merges pairs of bins, so we need an even number of them
+  bin_count_ = std::max<size_t>(2, bin_count + (bin_count % 2));
+  column_count_ = std::max<size_t>(1, column_count);
+  auto_range_ = !(max > min);
+  min_ = auto_range_ ? 0 : min;
+  max_ = auto_range_ ? 0 : max;
+  bin_width_ = auto_range_ ? 0 : (max_ - min_) / bin_count_;
+  counts_.assign(bin_count_ * column_count_, 0);
+  current_ = column_count_ - 1;
+  clear();
+}
+
+void Histogram::clear() {
+  std::fill(counts_.begin(), counts_.end(), 0);
+  has_range_ = !auto_range_;
+  max_count_ = 0;
+  total_ = 0;
+  mark_all_changed();
+}
+
+void Histogram::add(float value) {
+  if (bin_count_ == 0 || !std::isfinite(value)) {
+    return;
+  }
+  if (!has_range_) {
+    // start with unit bins centered on the first value
+    min_ = std::floor(value) - bin_count_ / 2;
+    max_ = min_ + bin_count_;
+    bin_width_ = 1;
+    has_range_ = true;
+  }
+  if (auto_range_ && (value < min_ || value >= max_)) {
+    expand_range(value);
+  }
+  // values outside of a fixed range are counted in the edge bins; clamp before
+  // converting, since far out values don't fit into an int
+  float position = std::floor((value - min_) / bin_width_);
+  size_t bin = static_cast<size_t>(std::clamp(position, 0.0f, static_cast<float>(bin_count_ - 1)));
+  auto &count = counts_[current_ * bin_count_ + bin];
+  count++;
+  total_++;
+  max_count_ = std::max(max_count_, count);
+  mark_changed(bin);
+}
+
+void Histogram::advance() {
+  current_ = (current_ + 1) % column_count_;
+  auto column = counts_.begin() + current_ * bin_count_;
+  std::fill(column, column + bin_count_, 0);
+  max_count_ = counts_.empty() ? 0 : *std::max_element(counts_.begin(), counts_.end());
+  mark_all_changed();
+}
+
+uint32_t Histogram::count(size_t bin, size_t column) const {
+  size_t index = (current_ + 1 + column) % column_count_;
+  return counts_[index * bin_count_ + bin];
+}
+
+void Histogram::expand_range(float value) {
+  const size_t half = bin_count_ / 2;
+  while (value < min_ || value >= max_) {
+    float width = max_ - min_;
+    bool grow_up = value >= max_;
+    for (size_t column = 0; column < column_count_; column++) {
+      auto bins = &counts_[column * bin_count_];
+      if (grow_up) {
+        // merge the pairs of bins into the lower half and keep the minimum
+        for (size_t i = 0; i < half; i++) {
+          bins[i] = bins[2 * i] + bins[2 * i + 1];
+        }
+        std::fill(bins + half, bins + bin_count_, 0);
+      } else {
+        // merge the pairs of bins into the upper half and keep the maximum
+        for (size_t i = bin_count_; i-- > half;) {
+          bins[i] = bins[2 * (i - half)] + bins[2 * (i - half) + 1];
+        }
+        std::fill(bins, bins + half, 0);
+      }
+    }
+    if (grow_up) {
+      max_ = min_ + 2 * width;
+    } else {
+      min_ = max_ - 2 * width;
+    }
+  }
+  bin_width_ = (max_ - min_) / bin_count_;
+  max_count_ = *std::max_element(counts_.begin(), counts_.end());
+  mark_all_changed();
+}
+
+void Histogram::mark_changed(size_t bin) {
+  first_changed_ = std::min(first_changed_, bin);
+  last_changed_ = std::max(last_changed_, bin);
+}
+
+void Histogram::mark_all_changed() {
+  all_changed_ = true;
+  first_changed_ = 0;
+  last_changed_ = bin_count_ > 0 ? bin_count_ - 1 : 0;
+}
+
+void Histogram::clear_changes() {
+  all_changed_ = false;
+  first_changed_ = SIZE_MAX;
+  last_changed_ = 0;
+}
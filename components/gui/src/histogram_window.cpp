@@ -0,0 +1,237 @@
+#include "histogram_window.hpp"
+
+#include <algorithm>
+
+#include "format.hpp"
+
+HistogramWindow::~HistogramWindow() {
+  // the lvgl objects are deleted along with our parent, but the canvas buffer
+  // is ours to free
+  if (canvas_buf_) {
+    lv_draw_buf_destroy(canvas_buf_);
+  }
+}
+
+void HistogramWindow::init(lv_obj_t *parent, size_t width, size_t height) {
+  Window::init(parent, width, height);
+  // create a transparent wrapper for the title and the plot area
+  wrapper_ = lv_obj_create(parent_);
+  lv_obj_remove_style_all(wrapper_);
+  lv_obj_set_size(wrapper_, lv_pct(100), lv_pct(100));
+  lv_obj_set_flex_flow(wrapper_, LV_FLEX_FLOW_COLUMN);
+
+  // the title shows the name, range and statistics of the series
+  title_ = lv_label_create(wrapper_);
+  lv_obj_set_width(title_, lv_pct(100));
+  lv_label_set_long_mode(title_, LV_LABEL_LONG_WRAP);
+  lv_label_set_text(title_, "");
+
+  // the plot area takes up the rest of the window
+  plot_area_ = lv_obj_create(wrapper_);
+  lv_obj_remove_style_all(plot_area_);
+  lv_obj_set_width(plot_area_, lv_pct(100));
+  lv_obj_set_flex_grow(plot_area_, 1);
+  lv_obj_remove_flag(plot_area_, LV_OBJ_FLAG_SCROLLABLE);
+
+  // heatmap colors go from blue (few samples) to red (most samples)
+  for (size_t i = 0; i < palette_.size(); i++) {
+    uint16_t hue = 240 - 240 * i / (palette_.size() - 1);
+    palette_[i] = lv_color_to_u16(lv_color_hsv_to_rgb(hue, 100, 100));
+  }
+}
+
+void HistogramWindow::configure(const std::string &name, const Config &config) {
+  name_ = name;
+  config_ = config;
+  config_.bin_count = std::clamp<size_t>(config_.bin_count, 1, max_bin_count);
+  delete_plot();
+  size_t column_count = config_.type == Type::HEATMAP ? heatmap_column_count : 1;
+  histogram_.configure(config_.bin_count, column_count, config_.min, config_.max);
+  stats_.reset();
+  stats_changed_ = true;
+  scale_ = 0;
+  if (config_.type == Type::HEATMAP) {
+    create_heatmap();
+  } else {
+    create_bars();
+  }
+  column_start_ = std::chrono::steady_clock::now();
+}
+
+void HistogramWindow::clear() {
+  histogram_.clear();
+  stats_.reset();
+  stats_changed_ = true;
+  column_start_ = std::chrono::steady_clock::now();
+}
+
+void HistogramWindow::add_data(int new_data) {
+  // only bin the data here, the bars are updated (at most once per frame) in
+  // update()
+  histogram_.add(new_data);
+  stats_.add(new_data);
+  stats_changed_ = true;
+}
+
+void HistogramWindow::create_bars() {
+  // make sure the plot area has its final size before we lay out the bars
+  lv_obj_update_layout(wrapper_);
+  int32_t area_width = lv_obj_get_content_width(plot_area_);
+  size_t bin_count = histogram_.bin_count();
+  bars_.resize(bin_count);
+  bar_heights_.assign(bin_count, 0);
+  for (size_t i = 0; i < bin_count; i++) {
+    // each bar is its own object, so changing its height only invalidates the
+    // area of that bar
+    auto bar = lv_obj_create(plot_area_);
+    lv_obj_remove_style_all(bar);
+    lv_obj_set_style_bg_opa(bar, LV_OPA_COVER, 0);
+    lv_obj_set_style_bg_color(bar, lv_palette_main(LV_PALETTE_BLUE), 0);
+    int32_t x = i * area_width / bin_count;
+    int32_t bar_width = std::max<int32_t>(1, (i + 1) * area_width / bin_count - x - 1);
+    lv_obj_set_size(bar, bar_width, 0);
+    // align to the bottom, so that the bars grow upwards
+    lv_obj_align(bar, LV_ALIGN_BOTTOM_LEFT, x, 0);
+    bars_[i] = bar;
+  }
+}
+
+void HistogramWindow::create_heatmap() {
+  // the canvas has one pixel per bin per column and is stretched to fill the
+  // plot area, which keeps the buffer small
+  canvas_buf_ = lv_draw_buf_create(heatmap_column_count, histogram_.bin_count(),
+                                   LV_COLOR_FORMAT_RGB565, LV_STRIDE_AUTO);
+  lv_draw_buf_clear(canvas_buf_, nullptr);
+  canvas_ = lv_canvas_create(plot_area_);
+  lv_canvas_set_draw_buf(canvas_, canvas_buf_);
+  lv_image_set_inner_align(canvas_, LV_IMAGE_ALIGN_STRETCH);
+  lv_image_set_antialias(canvas_, false);
+  lv_obj_set_size(canvas_, lv_pct(100), lv_pct(100));
+}
+
+void HistogramWindow::delete_plot() {
+  for (auto bar : bars_) {
+    lv_obj_delete(bar);
+  }
+  bars_.clear();
+  bar_heights_.clear();
+  if (canvas_) {
+    lv_obj_delete(canvas_);
+    canvas_ = nullptr;
+  }
+  if (canvas_buf_) {
+    lv_draw_buf_destroy(canvas_buf_);
+    canvas_buf_ = nullptr;
+  }
+}
+
+uint32_t HistogramWindow::get_scale() const {
+  // round up to a power of two, so that we only have to redraw every bar when
+  // the largest count doubles
+  uint32_t scale = 1;
+  while (scale < histogram_.max_count()) {
+    scale <<= 1;
+  }
+  return scale;
+}
+
+void HistogramWindow::update() {
+  auto now = std::chrono::steady_clock::now();
+  if (config_.type == Type::HEATMAP) {
+    // scroll the heatmap, but never by more than its width
+    size_t num_columns = 0;
+    while (now - column_start_ >= heatmap_column_period && num_columns < heatmap_column_count) {
+      histogram_.advance();
+      column_start_ += heatmap_column_period;
+      num_columns++;
+    }
+    if (now - column_start_ >= heatmap_column_period) {
+      column_start_ = now;
+    }
+  }
+
+  if (stats_changed_ && now - title_updated_ >= title_update_period) {
+    update_title();
+    title_updated_ = now;
+  }
+
+  if (!histogram_.has_changes()) {
+    return;
+  }
+  auto scale = get_scale();
+  bool redraw_all = histogram_.all_changed() || scale != scale_;
+  scale_ = scale;
+  if (config_.type == Type::HEATMAP) {
+    update_heatmap(redraw_all);
+  } else {
+    update_bars(redraw_all);
+  }
+  histogram_.clear_changes();
+}
+
+void HistogramWindow::update_title() {
+  std::string title = fmt::format("{}: {} bins [{:.4g}, {:.4g})\n{}", name_, histogram_.bin_count(),
+                                  histogram_.min(), histogram_.max(), stats_.to_string());
+  lv_label_set_text(title_, title.c_str());
+  stats_changed_ = false;
+}
+
+void HistogramWindow::update_bars(bool redraw_all) {
+  if (bars_.empty()) {
+    return;
+  }
+  int32_t area_height = lv_obj_get_content_height(plot_area_);
+  size_t first = redraw_all ? 0 : histogram_.first_changed_bin();
+  size_t last = redraw_all ? bars_.size() - 1 : histogram_.last_changed_bin();
+  for (size_t i = first; i <= last; i++) {
+    int32_t height = static_cast<int64_t>(histogram_.count(i)) * area_height / scale_;
+    if (height == bar_heights_[i]) {
+      continue;
+    }
+    lv_obj_set_height(bars_[i], height);
+    bar_heights_[i] = height;
+  }
+}
+
+void HistogramWindow::update_heatmap(bool redraw_all) {
+  if (!canvas_) {
+    return;
+  }
+  const size_t current_column = heatmap_column_count - 1;
+  if (redraw_all) {
+    for (size_t column = 0; column < heatmap_column_count; column++) {
+      draw_heatmap_column(column, 0, histogram_.bin_count() - 1);
+    }
+  } else {
+    draw_heatmap_column(current_column, histogram_.first_changed_bin(),
+                        histogram_.last_changed_bin());
+  }
+  // we modified the buffer directly, so make sure lvgl doesn't draw a cached
+  // copy of it
+  lv_image_cache_drop(canvas_buf_);
+  if (redraw_all) {
+    lv_obj_invalidate(canvas_);
+    return;
+  }
+  // only the current (right-most) column changed
+  lv_area_t area;
+  lv_obj_get_coords(canvas_, &area);
+  int32_t column_width = lv_area_get_width(&area) / heatmap_column_count + 1;
+  area.x1 = std::max(area.x1, area.x2 - column_width);
+  lv_obj_invalidate_area(canvas_, &area);
+}
+
+void HistogramWindow::draw_heatmap_column(size_t column, size_t first_bin, size_t last_bin) {
+  const size_t bin_count = histogram_.bin_count();
+  for (size_t bin = first_bin; bin <= last_bin; bin++) {
+    uint32_t count = histogram_.count(bin, column);
+    uint16_t color = 0;
+    if (count > 0) {
+      color = palette_[static_cast<uint64_t>(count) * (palette_.size() - 1) / scale_];
+    }
+    // larger values are at the top of the heatmap
+    auto pixel = reinterpret_cast<uint16_t *>(
+        lv_draw_buf_goto_xy(canvas_buf_, column, bin_count - 1 - bin));
+    *pixel = color;
+  }
+}
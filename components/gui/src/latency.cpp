@@ -0,0 +1,163 @@
+#include "latency.hpp"
+
+#include <algorithm>
+
+#include "format.hpp"
+
+void LatencyHistogram::add(int64_t latency_us) {
+  // clocks of different devices may make a latency slightly negative
+  latency_us = std::max<int64_t>(latency_us, 0);
+  // each bucket holds the latencies up to and including its bound
+  size_t index = std::lower_bound(bucket_bounds_us.begin(), bucket_bounds_us.end(), latency_us) -
+                 bucket_bounds_us.begin();
+  buckets_[index]++;
+  if (count_ == 0) {
+    min_us_ = latency_us;
+    max_us_ = latency_us;
+  } else {
+    min_us_ = std::min(min_us_, latency_us);
+    max_us_ = std::max(max_us_, latency_us);
+  }
+  count_++;
+  sum_us_ += latency_us;
+}
+
+void LatencyHistogram::reset() {
+  buckets_.fill(0);
+  count_ = 0;
+  sum_us_ = 0;
+  min_us_ = 0;
+  max_us_ = 0;
+}
+
+float LatencyHistogram::percentile_us(float percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  float target = std::clamp(percentile, 0.0f, 1.0f) * count_;
+  size_t below = 0;
+  for (size_t i = 0; i < bucket_count; i++) {
+    if (buckets_[i] == 0 || below + buckets_[i] < target) {
+      below += buckets_[i];
+      continue;
+    }
+    // interpolate within the bucket, whose edges are narrowed by the min / max
+    float low = std::max<float>(i == 0 ? 0 : bucket_bounds_us[i - 1], min_us_);
+    float high = std::min<float>(i < bucket_bounds_us.size() ? bucket_bounds_us[i] : max_us_,
+                                 max_us_);
+    return low + (high - low) * std::max(target - below, 0.0f) / buckets_[i];
+  }
+  return max_us_;
+}
+
+std::string LatencyHistogram::to_string() const {
+  return fmt::format("n {} min {:.2f}ms mean {:.2f}ms p50 {:.2f}ms p99 {:.2f}ms max {:.2f}ms",
+                     count_, min_us_ / 1000.0f, mean_us() / 1000.0f,
+                     percentile_us(0.5f) / 1000.0f, percentile_us(0.99f) / 1000.0f,
+                     max_us_ / 1000.0f);
+}
+
+void ClockOffset::add(int64_t local_us, int64_t remote_us) {
+  if (!current_min_ || local_us - window_start_us_ >= window_us) {
+    previous_min_ = current_min_;
+    current_min_.reset();
+    window_start_us_ = local_us;
+  }
+  int64_t offset = local_us - remote_us;
+  current_min_ = current_min_ ? std::min(*current_min_, offset) : offset;
+}
+
+std::optional<int64_t> ClockOffset::offset_us() const {
+  if (current_min_ && previous_min_) {
+    return std::min(*current_min_, *previous_min_);
+  }
+  return current_min_;
+}
+
+const char *LatencyTracker::stage_name(Stage stage) {
+  switch (stage) {
+  case NETWORK:
+    return "network";
+  case RECEIVE:
+    return "receive";
+  case QUEUE:
+    return "queue";
+  case PARSE:
+    return "parse";
+  case RENDER:
+    return "render";
+  case TOTAL:
+    return "total";
+  case END_TO_END:
+    return "end-to-end";
+  default:
+    return "unknown";
+  }
+}
+
+int64_t LatencyTracker::to_us(Clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+}
+
+void LatencyTracker::on_parsed(const std::string &sender, const Trace &trace,
+                               Clock::time_point popped, Clock::time_point parsed) {
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  add(RECEIVE, duration_cast<microseconds>(trace.queued - trace.received).count());
+  add(QUEUE, duration_cast<microseconds>(popped - trace.queued).count());
+  add(PARSE, duration_cast<microseconds>(parsed - popped).count());
+
+  std::optional<int64_t> sent;
+  if (trace.sender_time_us) {
+    // each sender has its own clock
+    auto it = clock_offsets_.find(sender);
+    if (it == clock_offsets_.end() && clock_offsets_.size() < max_senders) {
+      it = clock_offsets_.emplace(sender, ClockOffset{}).first;
+    }
+    if (it != clock_offsets_.end()) {
+      int64_t received_us = to_us(trace.received);
+      it->second.add(received_us, *trace.sender_time_us);
+      sent = static_cast<int64_t>(*trace.sender_time_us) + *it->second.offset_us();
+      add(NETWORK, received_us - *sent);
+    }
+  }
+
+  if (pending_.size() >= max_pending) {
+    num_untracked_++;
+    return;
+  }
+  pending_.push_back({trace.received, parsed, sent});
+}
+
+void LatencyTracker::on_rendered(Clock::time_point rendered) {
+  using std::chrono::duration_cast;
+  using std::chrono::microseconds;
+  int64_t rendered_us = to_us(rendered);
+  for (const auto &pending : pending_) {
+    add(RENDER, duration_cast<microseconds>(rendered - pending.parsed).count());
+    add(TOTAL, duration_cast<microseconds>(rendered - pending.received).count());
+    if (pending.sent) {
+      add(END_TO_END, rendered_us - *pending.sent);
+    }
+  }
+  pending_.clear();
+}
+
+void LatencyTracker::reset() {
+  for (auto &histogram : histograms_) {
+    histogram.reset();
+  }
+  clock_offsets_.clear();
+  pending_.clear();
+  num_untracked_ = 0;
+}
+
+std::vector<std::pair<std::string, int64_t>> LatencyTracker::get_clock_offsets_us() const {
+  std::vector<std::pair<std::string, int64_t>> offsets;
+  for (const auto &[sender, offset] : clock_offsets_) {
+    if (auto offset_us = offset.offset_us()) {
+      offsets.emplace_back(sender, *offset_us);
+    }
+  }
+  return offsets;
+}
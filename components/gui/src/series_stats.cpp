@@ -0,0 +1,166 @@
+#include "series_stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "format.hpp"
+
+P2Quantile::P2Quantile(float quantile)
+    : quantile_(quantile) {
+  reset();
+}
+
+void P2Quantile::reset() {
+  count_ = 0;
+  heights_.fill(0);
+  positions_ = {0, 1, 2, 3, 4};
+  desired_positions_ = {0, 2 * quantile_, 4 * quantile_, 2 + 2 * quantile_, 4};
+  increments_ = {0, quantile_ / 2, quantile_, (1 + quantile_) / 2, 1};
+}
+
+void P2Quantile::add(float value) {
+  // the first five samples simply initialize the marker heights
+  if (count_ < heights_.size()) {
+    heights_[count_++] = value;
+    if (count_ == heights_.size()) {
+      std::sort(heights_.begin(), heights_.end());
+    }
+    return;
+  }
+  count_++;
+
+  // find the cell the new sample falls into, extending the extremes if needed
+  int cell;
+  if (value < heights_[0]) {
+    heights_[0] = value;
+    cell = 0;
+  } else if (value >= heights_[4]) {
+    heights_[4] = value;
+    cell = 3;
+  } else {
+    cell = 0;
+    while (cell < 3 && value >= heights_[cell + 1]) {
+      cell++;
+    }
+  }
+
+  // shift the positions of the markers above the cell
+  for (int i = cell + 1; i < 5; i++) {
+    positions_[i] += 1;
+  }
+  for (int i = 0; i < 5; i++) {
+    desired_positions_[i] += increments_[i];
+  }
+
+  // move the middle markers towards their desired positions
+  for (int i = 1; i < 4; i++) {
+    float delta = desired_positions_[i] - positions_[i];
+    if ((delta >= 1 && positions_[i + 1] - positions_[i] > 1) ||
+        (delta <= -1 && positions_[i - 1] - positions_[i] < -1)) {
+      int d = delta > 0 ? 1 : -1;
+      float height = parabolic(i, d);
+      if (heights_[i - 1] < height && height < heights_[i + 1]) {
+        heights_[i] = height;
+      } else {
+        heights_[i] = linear(i, d);
+      }
+      positions_[i] += d;
+    }
+  }
+}
+
+float P2Quantile::parabolic(int i, float d) const {
+  return heights_[i] +
+         d / (positions_[i + 1] - positions_[i - 1]) *
+             ((positions_[i] - positions_[i - 1] + d) * (heights_[i + 1] - heights_[i]) /
+                  (positions_[i + 1] - positions_[i]) +
+              (positions_[i + 1] - positions_[i] - d) * (heights_[i] - heights_[i - 1]) /
+                  (positions_[i] - positions_[i - 1]));
+}
+
+float P2Quantile::linear(int i, int d) const {
+  return heights_[i] + d * (heights_[i + d] - heights_[i]) / (positions_[i + d] - positions_[i]);
+}
+
+float P2Quantile::value() const {
+  if (count_ == 0) {
+    return 0;
+  }
+  if (count_ < heights_.size()) {
+    // not enough samples for the markers yet, so use the exact quantile
+    std::array<float, 5> sorted = heights_;
+    std::sort(sorted.begin(), sorted.begin() + count_);
+    return sorted[static_cast<size_t>(std::round(quantile_ * (count_ - 1)))];
+  }
+  return heights_[2];
+}
+
+void SeriesStats::add(float value) {
+  auto now = Clock::now();
+  count_++;
+  last_ = value;
+  if (count_ == 1) {
+    min_ = value;
+    max_ = value;
+    window_start_ = now;
+  } else {
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+
+  // Welford's online mean / variance
+  float delta = value - mean_;
+  mean_ += delta / count_;
+  m2_ += delta * (value - mean_);
+
+  p50_.add(value);
+  p99_.add(value);
+
+  // count samples over a fixed window to get the sample rate
+  window_count_++;
+  auto elapsed = now - window_start_;
+  if (elapsed >= rate_window) {
+    rate_ = window_count_ / std::chrono::duration<float>(elapsed).count();
+    window_start_ = now;
+    window_count_ = 0;
+  }
+}
+
+float SeriesStats::stddev() const {
+  if (count_ < 2) {
+    return 0;
+  }
+  return std::sqrt(m2_ / (count_ - 1));
+}
+
+float SeriesStats::rate() const {
+  if (count_ < 2) {
+    return 0;
+  }
+  auto elapsed = Clock::now() - window_start_;
+  if (rate_ > 0 && elapsed < 2 * rate_window) {
+    return rate_;
+  }
+  // either we haven't completed a full window yet or the series has gone
+  // quiet, so estimate from the samples in the current window
+  auto seconds = std::chrono::duration<float>(elapsed).count();
+  return seconds > 0 ? window_count_ / seconds : 0;
+}
+
+std::string SeriesStats::to_string() const {
+  return fmt::format("{:.4g} [{:.4g}, {:.4g}] {:.3g}+/-{:.2g} p50 {:.3g} p99 {:.3g} {:.1f}Hz", last(),
+                     min(), max(), mean(), stddev(), p50(), p99(), rate());
+}
+
+void SeriesStats::reset() {
+  count_ = 0;
+  last_ = 0;
+  min_ = 0;
+  max_ = 0;
+  mean_ = 0;
+  m2_ = 0;
+  p50_.reset();
+  p99_.reset();
+  window_count_ = 0;
+  rate_ = 0;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <lvgl.h>
+
+#include "logger.hpp"
+#include "task.hpp"
+#include "udp_socket.hpp"
+
+/// Mirrors the screen to a subscribed host. The areas which LVGL flushes to
+/// the display (i.e. only what changed) are run-length encoded into
+/// MirrorRect packets as they are flushed, and sent from a separate task so
+/// that rendering never waits on the network. Packets are encoded straight into
+/// a preallocated ring of packets, so rendering never allocates either. If the
+/// network can't keep up, areas are dropped (without encoding them) and the
+/// whole screen is sent again once it can.
+///
+/// The mirror must be created before the gui task starts, since it registers
+/// with LVGL.
+class Mirror {
+public:
+  struct Config {
+    lv_display_t *display{nullptr}; ///< Display to mirror (RGB565)
+    size_t packet_size{1024};       ///< Maximum size of each packet
+    size_t max_queued_bytes{16 * 1024}; ///< Size of the ring of queued packets
+    espp::Logger::Verbosity log_level{espp::Logger::Verbosity::WARN}; ///< Log level
+  };
+
+  explicit Mirror(const Config &config);
+  ~Mirror();
+
+  /// Start streaming to ip:port, beginning with the whole screen.
+  void subscribe(const std::string &ip, size_t port);
+  void unsubscribe();
+  bool is_subscribed() const { return subscribed_; }
+
+  /// Summary of the traffic so far, for the CLI.
+  std::string get_stats() const;
+
+protected:
+  static constexpr auto refresh_check_period_ms = 100;
+
+  static void on_flush_start(lv_event_t *e);
+  static void on_refresh_timer(lv_timer_t *timer);
+
+  void encode(const lv_area_t &area, const uint8_t *px_map);
+  uint8_t *reserve_packet();
+  void queue_packet(size_t size);
+  void clear_queue();
+  bool send_packets();
+
+  Config config_;
+  lv_timer_t *refresh_timer_{nullptr};
+  uint16_t frame_{0};
+
+  std::atomic<bool> subscribed_{false};
+  std::atomic<bool> needs_refresh_{false}; ///< Whether to send the whole screen again
+  std::mutex mutex_;                       ///< Protects the members below
+  std::condition_variable cv_;
+  std::string ip_;
+  size_t port_{0};
+  std::vector<std::vector<uint8_t>> packets_; ///< Ring of packets, allocated up front
+  std::vector<size_t> packet_sizes_;
+  size_t head_{0};       ///< Oldest queued packet, which is being sent if sending_
+  size_t num_queued_{0}; ///< Queued packets, including the one being sent
+  bool sending_{false};
+  size_t generation_{0};          ///< Incremented when the queue is cleared
+  size_t reserved_generation_{0}; ///< Generation of the packet being encoded
+
+  std::atomic<size_t> num_frames_{0};
+  std::atomic<size_t> num_pixels_{0};
+  std::atomic<size_t> num_packets_{0};
+  std::atomic<size_t> num_bytes_{0};
+  std::atomic<size_t> num_dropped_{0}; ///< Areas dropped because the queue was full
+
+  espp::UdpSocket socket_;
+  std::unique_ptr<espp::Task> task_;
+  espp::Logger logger_;
+};
@@ -0,0 +1,206 @@
+#include "mirror.hpp"
+
+#include <algorithm>
+
+#include "format.hpp"
+#include "mirror_rect.hpp"
+
+using namespace std::chrono_literals;
+
+Mirror::Mirror(const Config &config)
+    : config_(config)
+    , socket_({.log_level = espp::Logger::Verbosity::WARN})
+    , logger_({.tag = "Mirror", .level = config.log_level}) {
+  size_t num_packets = std::max<size_t>(config_.max_queued_bytes / config_.packet_size, 1);
+  packets_.assign(num_packets, std::vector<uint8_t>(config_.packet_size));
+  packet_sizes_.assign(num_packets, 0);
+  // LVGL sends this right before it hands each rendered area to the display
+  lv_display_add_event_cb(config_.display, &Mirror::on_flush_start, LV_EVENT_FLUSH_START, this);
+  refresh_timer_ = lv_timer_create(&Mirror::on_refresh_timer, refresh_check_period_ms, this);
+  task_ = espp::Task::make_unique(espp::Task::Config{
+      .callback = [this](auto &, auto &) -> bool { return send_packets(); },
+      .task_config = {.name = "Mirror", .stack_size_bytes = 4 * 1024}});
+  task_->start();
+}
+
+Mirror::~Mirror() {
+  unsubscribe();
+  task_->stop();
+  lv_timer_delete(refresh_timer_);
+  lv_display_remove_event_cb_with_user_data(config_.display, &Mirror::on_flush_start, this);
+}
+
+void Mirror::subscribe(const std::string &ip, size_t port) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ip_ = ip;
+    port_ = port;
+  }
+  clear_queue();
+  logger_.info("Mirroring to {}:{}", ip, port);
+  subscribed_ = true;
+  // the host starts with nothing, so send it the whole screen
+  needs_refresh_ = true;
+}
+
+void Mirror::unsubscribe() {
+  subscribed_ = false;
+  clear_queue();
+}
+
+void Mirror::clear_queue() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // the packet being sent stays at the head until it is done
+  num_queued_ = sending_ ? 1 : 0;
+  // and a packet which is being encoded is dropped
+  generation_++;
+}
+
+std::string Mirror::get_stats() const {
+  size_t bytes = num_bytes_;
+  size_t pixel_bytes = num_pixels_ * sizeof(uint16_t);
+  return fmt::format("{} frames, {} pixels in {} packets ({} bytes, {:.1f}% of raw), "
+                     "{} areas dropped",
+                     num_frames_.load(), num_pixels_.load(), num_packets_.load(), bytes,
+                     pixel_bytes ? 100.0f * bytes / pixel_bytes : 0.0f, num_dropped_.load());
+}
+
+void Mirror::on_flush_start(lv_event_t *e) {
+  auto mirror = static_cast<Mirror *>(lv_event_get_user_data(e));
+  if (!mirror || !mirror->subscribed_) {
+    return;
+  }
+  auto area = static_cast<const lv_area_t *>(lv_event_get_param(e));
+  auto buf = lv_display_get_buf_active(mirror->config_.display);
+  if (!area || !buf) {
+    return;
+  }
+  mirror->encode(*area, buf->data);
+}
+
+void Mirror::on_refresh_timer(lv_timer_t *timer) {
+  auto mirror = static_cast<Mirror *>(lv_timer_get_user_data(timer));
+  if (!mirror->subscribed_ || !mirror->needs_refresh_) {
+    return;
+  }
+  {
+    // wait for the network to catch up, otherwise the refresh is dropped too
+    std::lock_guard<std::mutex> lock(mirror->mutex_);
+    if (mirror->num_queued_ > 0) {
+      return;
+    }
+  }
+  mirror->needs_refresh_ = false;
+  // this runs in the LVGL thread, outside of rendering, so it can invalidate
+  lv_obj_invalidate(lv_screen_active());
+}
+
+void Mirror::encode(const lv_area_t &area, const uint8_t *px_map) {
+  auto display = config_.display;
+  const size_t width = lv_area_get_width(&area);
+  const size_t height = lv_area_get_height(&area);
+  const size_t stride =
+      lv_draw_buf_width_to_stride(width, lv_display_get_color_format(display)) / sizeof(uint16_t);
+  const auto *pixels = reinterpret_cast<const uint16_t *>(px_map);
+  const bool is_last_area = lv_display_flush_is_last(display);
+
+  // rows which wouldn't fit into a packet are split into strips
+  const size_t max_strip_width =
+      (config_.packet_size - MirrorRect::header_size) / MirrorRect::run_size;
+  bool dropped = false;
+  for (size_t strip_x = 0; strip_x < width && !dropped; strip_x += max_strip_width) {
+    const size_t strip_width = std::min(max_strip_width, width - strip_x);
+    const bool is_last_strip = strip_x + strip_width == width;
+    size_t row = 0;
+    while (row < height) {
+      MirrorRect rect;
+      rect.frame = frame_;
+      rect.screen_width = lv_display_get_horizontal_resolution(display);
+      rect.screen_height = lv_display_get_vertical_resolution(display);
+      rect.x = area.x1 + strip_x;
+      rect.y = area.y1 + row;
+      rect.width = strip_width;
+      uint8_t *packet = reserve_packet();
+      if (!packet) {
+        // the network can't keep up, so don't bother encoding the rest of the
+        // area; the whole screen is sent again once the queue drains
+        num_dropped_++;
+        needs_refresh_ = true;
+        dropped = true;
+        break;
+      }
+      size_t size = rect.encode(pixels + row * stride + strip_x, stride, height - row, packet,
+                                config_.packet_size);
+      if (size == 0) {
+        logger_.error("Packet size {} is too small to mirror", config_.packet_size);
+        return;
+      }
+      row += rect.height;
+      if (is_last_area && is_last_strip && row == height) {
+        rect.flags |= MirrorRect::FRAME_END;
+        rect.serialize_header(packet);
+      }
+      queue_packet(size);
+    }
+  }
+  num_pixels_ += width * height;
+  if (is_last_area) {
+    num_frames_++;
+    frame_++;
+  }
+}
+
+uint8_t *Mirror::reserve_packet() {
+  // only the LVGL thread queues packets, so the free packet after the queued
+  // ones stays free until it is queued
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (num_queued_ == packets_.size()) {
+    return nullptr;
+  }
+  reserved_generation_ = generation_;
+  return packets_[(head_ + num_queued_) % packets_.size()].data();
+}
+
+void Mirror::queue_packet(size_t size) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (reserved_generation_ != generation_) {
+      // the queue was cleared while encoding, so the packet may be in use
+      return;
+    }
+    packet_sizes_[(head_ + num_queued_) % packets_.size()] = size;
+    num_queued_++;
+  }
+  cv_.notify_one();
+}
+
+bool Mirror::send_packets() {
+  std::string_view packet;
+  espp::UdpSocket::SendConfig send_config;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait_for(lock, 100ms, [this] { return num_queued_ > 0; });
+    if (num_queued_ == 0) {
+      // check whether the task should stop
+      return false;
+    }
+    // the packet stays queued while it is sent, so that it isn't reused
+    packet = std::string_view(reinterpret_cast<const char *>(packets_[head_].data()),
+                              packet_sizes_[head_]);
+    sending_ = true;
+    send_config.ip_address = ip_;
+    send_config.port = port_;
+  }
+  if (socket_.send(packet, send_config)) {
+    num_packets_++;
+    num_bytes_ += packet.size();
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sending_ = false;
+    head_ = (head_ + 1) % packets_.size();
+    num_queued_--;
+  }
+  // don't want to stop the task
+  return false;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+#include "packet.hpp"
+
+/// Credit based flow control for senders, using the Acks which the display
+/// replies with. Each ack says how many more packets (credits) the display can
+/// queue beyond the acked one, so the sender never has more packets in flight
+/// than that and paces itself to the rate at which the display parses them.
+///
+/// It only keeps track of the sequence numbers and credits; sending the packets
+/// and receiving the acks is up to the sender:
+///
+///   if (flow_control.can_send()) {
+///     header.flags |= PacketHeader::ACK_REQUESTED;
+///     header.sequence = flow_control.on_send();
+///     // ... send the packet
+///   }
+///   // ... when an ack is received
+///   flow_control.on_ack(ack);
+class FlowControl {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Config {
+    uint16_t initial_credits{4}; ///< Packets which can be sent before the first ack
+    std::chrono::milliseconds ack_timeout{250}; ///< Send a probe if no ack arrives for this long
+  };
+
+  explicit FlowControl(const Config &config)
+      : config_(config)
+      , credits_(config.initial_credits) {}
+
+  /// Whether a packet can be sent now.
+  bool can_send(Clock::time_point now = Clock::now()) const;
+
+  /// Record that a packet is being sent, returning its sequence number.
+  uint32_t on_send(Clock::time_point now = Clock::now());
+
+  /// Update the credits from an ack, ignoring acks older than the latest one.
+  void on_ack(const Ack &ack, Clock::time_point now = Clock::now());
+
+  /// Number of packets sent which haven't been acked yet.
+  uint32_t in_flight() const { return next_sequence_ - (last_acked_ + 1); }
+
+  uint16_t credits() const { return credits_; }
+  uint16_t queue_depth() const { return queue_depth_; }
+  uint32_t num_dropped() const { return num_dropped_; }
+  uint32_t num_timeouts() const { return num_timeouts_; }
+
+protected:
+  Config config_;
+  uint32_t next_sequence_{0};
+  uint32_t last_acked_{UINT32_MAX}; ///< i.e. before the first packet
+  uint16_t credits_;                ///< Credits beyond last_acked_
+  uint16_t queue_depth_{0};
+  uint32_t num_dropped_{0};
+  uint32_t num_timeouts_{0};
+  Clock::time_point last_progress_{}; ///< Last time an ack arrived or a probe was sent
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// Minimal implementation of the LZ4 block format, which compresses text (such
+/// as logs and plot data) well, needs no memory for decompression beyond the
+/// output buffer, and decompresses very quickly on the ESP32. The compressor
+/// only uses a small (2 KiB) hash table on the stack, so it can be used on
+/// embedded senders as well.
+///
+/// Blocks are limited to 64 KiB of uncompressed data.
+class Lz4 {
+public:
+  static constexpr size_t max_input_size = 65535;
+
+  /// Worst case size of compressing size bytes (incompressible data).
+  static constexpr size_t max_compressed_size(size_t size) { return size + size / 255 + 16; }
+
+  /// Compress src into dst, returning the size of the compressed data or 0 if
+  /// it does not fit into dst (or src is too large).
+  static size_t compress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_capacity);
+
+  /// Decompress src into dst, returning the size of the decompressed data or 0
+  /// if src is malformed or does not fit into dst.
+  static size_t decompress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_capacity);
+};
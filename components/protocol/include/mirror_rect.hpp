@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// Packet of the screen mirror stream: (part of) a rectangle of the screen
+/// which was redrawn, run-length encoded. Each packet holds complete rows, so
+/// packets can be decoded independently (and lost ones only leave a stale
+/// area until it is redrawn).
+///
+///   | 0x00 | 'M' | flags | frame: u16 | screen width: u16 | screen height: u16 |
+///   | x: u16 | y: u16 | width: u16 | height: u16 | runs ... |
+///
+/// The runs cover the rectangle row by row, each is | count: u8 | pixel: u16 |
+/// with the pixel in RGB565. All fields are little-endian.
+class MirrorRect {
+public:
+  static constexpr uint8_t start_byte = 0x00;
+  static constexpr uint8_t magic = 'M';
+  static constexpr size_t header_size = 17;
+  static constexpr size_t run_size = 3;
+
+  enum Flags : uint8_t {
+    FRAME_END = 1 << 0, ///< The last rectangle of the frame, so it can be shown
+  };
+
+  uint8_t flags{0};
+  uint16_t frame{0};         ///< Frame counter, which wraps
+  uint16_t screen_width{0};  ///< Size of the whole screen
+  uint16_t screen_height{0}; ///< Size of the whole screen
+  uint16_t x{0};
+  uint16_t y{0};
+  uint16_t width{0};
+  uint16_t height{0};
+
+  bool has(Flags flag) const { return flags & flag; }
+
+  /// Worst case size of the runs of a row (no two neighbouring pixels equal).
+  static constexpr size_t max_row_size(size_t width) { return width * run_size; }
+
+  /// Encode as many of the num_rows rows of pixels (of width pixels, stride
+  /// pixels apart) as fit into data after the header, setting height to the
+  /// number of rows encoded and returning the size of the packet (0 if not
+  /// even one row fits). The header is written last, so set flags after.
+  size_t encode(const uint16_t *pixels, size_t stride, size_t num_rows, uint8_t *data,
+                size_t size);
+
+  /// Parse the header from data, returning false if it isn't a mirror packet.
+  bool parse(const uint8_t *data, size_t size);
+
+  /// Decode the runs of a parsed packet into the framebuffer of the screen
+  /// (screen_width x screen_height), returning false if they are malformed.
+  bool decode(const uint8_t *data, size_t size, uint16_t *framebuffer) const;
+
+  /// Serialize the header into data (of at least header_size bytes).
+  void serialize_header(uint8_t *data) const;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// Header of a binary packet sent to the display.
+///
+/// Plain text packets are still supported as-is. Binary packets start with a
+/// NUL byte (which never starts a text packet) and a magic byte, followed by a
+/// flags byte which says which of the optional fields follow, in the order of
+/// the flags. All fields are little-endian. The payload follows the header.
+///
+///   | 0x00 | 'W' | flags | [uncompressed size: u16] | [sequence: u32] | [timestamp: u64] |
+///   | payload ... |
+///
+/// The timestamp is the time the sender sent the packet, in microseconds of any
+/// monotonic clock of its own; the display estimates the offset to its clock.
+class PacketHeader {
+public:
+  static constexpr uint8_t start_byte = 0x00;
+  static constexpr uint8_t magic = 'W';
+
+  enum Flags : uint8_t {
+    COMPRESSED = 1 << 0,    ///< The payload is an LZ4 block of uncompressed_size bytes
+    ACK_REQUESTED = 1 << 1, ///< The display replies with an Ack for sequence
+    TIMESTAMP = 1 << 2,     ///< The sender's timestamp follows, to trace latency
+  };
+  static constexpr uint8_t known_flags = COMPRESSED | ACK_REQUESTED | TIMESTAMP;
+
+  /// Largest payload the display accepts once decompressed.
+  static constexpr size_t max_uncompressed_size = 4096;
+
+  uint8_t flags{0};
+  uint16_t uncompressed_size{0}; ///< Size of the payload once decompressed (COMPRESSED)
+  uint32_t sequence{0};          ///< Sequence number of the packet (ACK_REQUESTED)
+  uint64_t timestamp{0};         ///< Send time in microseconds, sender's clock (TIMESTAMP)
+
+  bool has(Flags flag) const { return flags & flag; }
+
+  /// Whether data starts with a binary packet header (as opposed to text).
+  static bool is_binary(const uint8_t *data, size_t size) {
+    return size >= 2 && data[0] == start_byte && data[1] == magic;
+  }
+
+  /// Size of the serialized header.
+  size_t size() const;
+
+  /// Parse a header from data, returning the size of the header or 0 if it is
+  /// invalid (truncated, or using flags we don't know about).
+  size_t parse(const uint8_t *data, size_t size);
+
+  /// Serialize the header into data, returning the size of the header or 0 if
+  /// it doesn't fit.
+  size_t serialize(uint8_t *data, size_t size) const;
+};
+
+/// Acknowledgement the display replies with to packets which request one, so
+/// that senders can pace themselves to what the display can actually handle.
+///
+///   | 0x00 | 'A' | flags | sequence: u32 | queue depth: u16 | credits: u16 |
+///
+/// The credits are the number of packets the display can queue, beyond the
+/// acked one, without dropping any.
+class Ack {
+public:
+  static constexpr uint8_t start_byte = 0x00;
+  static constexpr uint8_t magic = 'A';
+  static constexpr size_t serialized_size = 11;
+
+  enum Flags : uint8_t {
+    DROPPED = 1 << 0, ///< The packet was dropped, e.g. because the queue was full
+  };
+
+  uint8_t flags{0};
+  uint32_t sequence{0};     ///< Sequence number of the acked packet
+  uint16_t queue_depth{0};  ///< Number of packets waiting to be parsed
+  uint16_t credits{0};      ///< Number of packets which can still be queued
+
+  bool has(Flags flag) const { return flags & flag; }
+
+  /// Parse an ack from data, returning false if it isn't one.
+  bool parse(const uint8_t *data, size_t size);
+
+  /// Serialize the ack into data, returning its size or 0 if it doesn't fit.
+  size_t serialize(uint8_t *data, size_t size) const;
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// Record of the binary export of plot samples. A series is exported as one
+/// or more records, each of which fits into a single chunk (datagram):
+///
+///   | name length: u8 | name | sample count: u16 | samples: i32 ... |
+///
+/// All fields are little-endian. Names longer than 255 bytes are truncated.
+class SeriesRecord {
+public:
+  static constexpr size_t max_name_size = 255;
+
+  /// Size of a record holding the name and no samples.
+  static size_t header_size(const std::string &name);
+
+  /// Serialize the name and as many of the samples as fit into data,
+  /// returning the number of samples written (which may be 0) and setting
+  /// record_size to the size of the record, or to 0 if not even the header fits.
+  static size_t serialize(const std::string &name, const int32_t *samples, size_t count,
+                          uint8_t *data, size_t size, size_t &record_size);
+
+  /// Parse one record from data, returning its size or 0 if it is truncated.
+  static size_t parse(const uint8_t *data, size_t size, std::string &name,
+                      std::vector<int32_t> &samples);
+};
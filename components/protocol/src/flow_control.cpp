@@ -0,0 +1,38 @@
+#include "flow_control.hpp"
+
+bool FlowControl::can_send(Clock::time_point now) const {
+  if (in_flight() < credits_) {
+    return true;
+  }
+  // the ack (or the packet) may have been lost, so probe the display with one
+  // more packet rather than waiting forever
+  return now - last_progress_ >= config_.ack_timeout;
+}
+
+uint32_t FlowControl::on_send(Clock::time_point now) {
+  if (in_flight() >= credits_) {
+    // out of credits, so this is a probe after a timeout
+    num_timeouts_++;
+    last_progress_ = now;
+  } else if (in_flight() == 0) {
+    last_progress_ = now;
+  }
+  return next_sequence_++;
+}
+
+void FlowControl::on_ack(const Ack &ack, Clock::time_point now) {
+  // compare using the distance, so that the sequence numbers can wrap around
+  auto since_last = static_cast<int32_t>(ack.sequence - last_acked_);
+  auto before_next = static_cast<int32_t>(next_sequence_ - ack.sequence);
+  if (since_last <= 0 || before_next <= 0) {
+    // old, duplicated or bogus
+    return;
+  }
+  last_acked_ = ack.sequence;
+  credits_ = ack.credits;
+  queue_depth_ = ack.queue_depth;
+  if (ack.has(Ack::DROPPED)) {
+    num_dropped_++;
+  }
+  last_progress_ = now;
+}
@@ -0,0 +1,165 @@
+#include "lz4.hpp"
+
+#include <cstring>
+
+static constexpr size_t min_match = 4;
+static constexpr size_t last_literals = 5; ///< The last bytes of a block are always literals
+static constexpr size_t match_limit = 12;  ///< Matches must start this far from the end
+static constexpr size_t hash_bits = 10;
+
+static uint32_t read32(const uint8_t *p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static uint32_t hash(uint32_t sequence) { return (sequence * 2654435761u) >> (32 - hash_bits); }
+
+static uint8_t *write_length(uint8_t *op, const uint8_t *op_end, size_t length) {
+  // lengths of 15 or more continue in extra bytes of 255 each
+  while (length >= 255) {
+    if (op >= op_end) {
+      return nullptr;
+    }
+    *op++ = 255;
+    length -= 255;
+  }
+  if (op >= op_end) {
+    return nullptr;
+  }
+  *op++ = static_cast<uint8_t>(length);
+  return op;
+}
+
+static uint8_t *write_sequence(uint8_t *op, const uint8_t *op_end, const uint8_t *literals,
+                               size_t literal_length, size_t offset, size_t match_length) {
+  if (op >= op_end) {
+    return nullptr;
+  }
+  uint8_t *token = op++;
+  *token = (literal_length >= 15 ? 15 : literal_length) << 4;
+  if (literal_length >= 15 && !(op = write_length(op, op_end, literal_length - 15))) {
+    return nullptr;
+  }
+  if (static_cast<size_t>(op_end - op) < literal_length) {
+    return nullptr;
+  }
+  if (literal_length > 0) {
+    memcpy(op, literals, literal_length);
+    op += literal_length;
+  }
+  if (match_length == 0) {
+    // the last sequence only has literals
+    return op;
+  }
+  if (op_end - op < 2) {
+    return nullptr;
+  }
+  *op++ = offset & 0xff;
+  *op++ = offset >> 8;
+  match_length -= min_match;
+  *token |= match_length >= 15 ? 15 : match_length;
+  if (match_length >= 15 && !(op = write_length(op, op_end, match_length - 15))) {
+    return nullptr;
+  }
+  return op;
+}
+
+size_t Lz4::compress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_capacity) {
+  if (src_size > max_input_size) {
+    return 0;
+  }
+  // positions (+1, so that 0 means empty) of the last occurrence of each hash
+  uint16_t table[1 << hash_bits] = {0};
+  uint8_t *op = dst;
+  const uint8_t *op_end = dst + dst_capacity;
+  size_t anchor = 0;
+  size_t ip = 0;
+  if (src_size > match_limit) {
+    const size_t ip_limit = src_size - match_limit;
+    const size_t match_end = src_size - last_literals;
+    while (ip < ip_limit) {
+      uint32_t sequence = read32(src + ip);
+      uint32_t h = hash(sequence);
+      size_t ref = table[h];
+      table[h] = ip + 1;
+      if (ref == 0 || read32(src + ref - 1) != sequence) {
+        ip++;
+        continue;
+      }
+      ref--;
+      size_t match_length = min_match;
+      while (ip + match_length < match_end && src[ref + match_length] == src[ip + match_length]) {
+        match_length++;
+      }
+      op = write_sequence(op, op_end, src + anchor, ip - anchor, ip - ref, match_length);
+      if (!op) {
+        return 0;
+      }
+      ip += match_length;
+      anchor = ip;
+    }
+  }
+  op = write_sequence(op, op_end, src + anchor, src_size - anchor, 0, 0);
+  if (!op) {
+    return 0;
+  }
+  return op - dst;
+}
+
+static bool read_length(const uint8_t *&ip, const uint8_t *ip_end, size_t &length) {
+  uint8_t byte;
+  do {
+    if (ip >= ip_end) {
+      return false;
+    }
+    byte = *ip++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+size_t Lz4::decompress(const uint8_t *src, size_t src_size, uint8_t *dst, size_t dst_capacity) {
+  const uint8_t *ip = src;
+  const uint8_t *ip_end = src + src_size;
+  uint8_t *op = dst;
+  const uint8_t *op_end = dst + dst_capacity;
+  while (ip < ip_end) {
+    uint8_t token = *ip++;
+    size_t literal_length = token >> 4;
+    if (literal_length == 15 && !read_length(ip, ip_end, literal_length)) {
+      return 0;
+    }
+    if (static_cast<size_t>(ip_end - ip) < literal_length ||
+        static_cast<size_t>(op_end - op) < literal_length) {
+      return 0;
+    }
+    memcpy(op, ip, literal_length);
+    ip += literal_length;
+    op += literal_length;
+    if (ip == ip_end) {
+      // the last sequence has no match
+      break;
+    }
+    if (ip_end - ip < 2) {
+      return 0;
+    }
+    size_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    size_t match_length = token & 0x0f;
+    if (match_length == 15 && !read_length(ip, ip_end, match_length)) {
+      return 0;
+    }
+    match_length += min_match;
+    if (offset == 0 || offset > static_cast<size_t>(op - dst) ||
+        static_cast<size_t>(op_end - op) < match_length) {
+      return 0;
+    }
+    // the match may overlap the output, so copy byte by byte
+    const uint8_t *match = op - offset;
+    for (size_t i = 0; i < match_length; i++) {
+      *op++ = match[i];
+    }
+  }
+  return op - dst;
+}
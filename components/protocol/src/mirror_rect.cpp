@@ -0,0 +1,93 @@
+#include "mirror_rect.hpp"
+
+static void write_u16(uint8_t *data, uint16_t value) {
+  data[0] = value & 0xff;
+  data[1] = value >> 8;
+}
+
+static uint16_t read_u16(const uint8_t *data) { return data[0] | (data[1] << 8); }
+
+size_t MirrorRect::encode(const uint16_t *pixels, size_t stride, size_t num_rows, uint8_t *data,
+                          size_t size) {
+  uint8_t *p = data + header_size;
+  const uint8_t *end = data + size;
+  size_t row = 0;
+  // only start a row if it fits even if it doesn't compress at all
+  for (; row < num_rows && static_cast<size_t>(end - p) >= max_row_size(width); row++) {
+    const uint16_t *pixel = pixels + row * stride;
+    const uint16_t *row_end = pixel + width;
+    while (pixel < row_end) {
+      uint16_t value = *pixel;
+      size_t count = 1;
+      while (pixel + count < row_end && pixel[count] == value && count < 255) {
+        count++;
+      }
+      *p++ = count;
+      write_u16(p, value);
+      p += 2;
+      pixel += count;
+    }
+  }
+  if (row == 0 || size < header_size) {
+    return 0;
+  }
+  height = row;
+  serialize_header(data);
+  return p - data;
+}
+
+void MirrorRect::serialize_header(uint8_t *data) const {
+  data[0] = start_byte;
+  data[1] = magic;
+  data[2] = flags;
+  write_u16(data + 3, frame);
+  write_u16(data + 5, screen_width);
+  write_u16(data + 7, screen_height);
+  write_u16(data + 9, x);
+  write_u16(data + 11, y);
+  write_u16(data + 13, width);
+  write_u16(data + 15, height);
+}
+
+bool MirrorRect::parse(const uint8_t *data, size_t size) {
+  if (size < header_size || data[0] != start_byte || data[1] != magic) {
+    return false;
+  }
+  flags = data[2];
+  frame = read_u16(data + 3);
+  screen_width = read_u16(data + 5);
+  screen_height = read_u16(data + 7);
+  x = read_u16(data + 9);
+  y = read_u16(data + 11);
+  width = read_u16(data + 13);
+  height = read_u16(data + 15);
+  return true;
+}
+
+bool MirrorRect::decode(const uint8_t *data, size_t size, uint16_t *framebuffer) const {
+  if (x + width > screen_width || y + height > screen_height) {
+    return false;
+  }
+  const uint8_t *p = data + header_size;
+  const uint8_t *end = data + size;
+  for (size_t row = 0; row < height; row++) {
+    uint16_t *pixel = framebuffer + (y + row) * screen_width + x;
+    size_t remaining = width;
+    while (remaining > 0) {
+      if (end - p < static_cast<ptrdiff_t>(run_size)) {
+        return false;
+      }
+      size_t count = p[0];
+      uint16_t value = read_u16(p + 1);
+      p += run_size;
+      if (count == 0 || count > remaining) {
+        return false;
+      }
+      for (size_t i = 0; i < count; i++) {
+        *pixel++ = value;
+      }
+      remaining -= count;
+    }
+  }
+  return p == end;
+}
@@ -0,0 +1,119 @@
+#include "packet.hpp"
+
+static constexpr size_t fixed_size = 3; ///< start byte, magic and flags
+
+static void write_u16(uint8_t *data, uint16_t value) {
+  data[0] = value & 0xff;
+  data[1] = value >> 8;
+}
+
+static void write_u32(uint8_t *data, uint32_t value) {
+  write_u16(data, value & 0xffff);
+  write_u16(data + 2, value >> 16);
+}
+
+static void write_u64(uint8_t *data, uint64_t value) {
+  write_u32(data, value & 0xffffffff);
+  write_u32(data + 4, value >> 32);
+}
+
+static uint16_t read_u16(const uint8_t *data) { return data[0] | (data[1] << 8); }
+
+static uint32_t read_u32(const uint8_t *data) {
+  return read_u16(data) | (static_cast<uint32_t>(read_u16(data + 2)) << 16);
+}
+
+static uint64_t read_u64(const uint8_t *data) {
+  return read_u32(data) | (static_cast<uint64_t>(read_u32(data + 4)) << 32);
+}
+
+size_t PacketHeader::size() const {
+  size_t size = fixed_size;
+  if (has(COMPRESSED)) {
+    size += sizeof(uint16_t);
+  }
+  if (has(ACK_REQUESTED)) {
+    size += sizeof(uint32_t);
+  }
+  if (has(TIMESTAMP)) {
+    size += sizeof(uint64_t);
+  }
+  return size;
+}
+
+size_t PacketHeader::parse(const uint8_t *data, size_t size) {
+  if (size < fixed_size || !is_binary(data, size)) {
+    return 0;
+  }
+  flags = data[2];
+  if (flags & ~known_flags) {
+    // we can't know where the payload starts
+    return 0;
+  }
+  size_t header_size = this->size();
+  if (size < header_size) {
+    return 0;
+  }
+  const uint8_t *field = data + fixed_size;
+  if (has(COMPRESSED)) {
+    uncompressed_size = read_u16(field);
+    field += sizeof(uint16_t);
+  }
+  if (has(ACK_REQUESTED)) {
+    sequence = read_u32(field);
+    field += sizeof(uint32_t);
+  }
+  if (has(TIMESTAMP)) {
+    timestamp = read_u64(field);
+    field += sizeof(uint64_t);
+  }
+  return header_size;
+}
+
+size_t PacketHeader::serialize(uint8_t *data, size_t size) const {
+  size_t header_size = this->size();
+  if (size < header_size) {
+    return 0;
+  }
+  data[0] = start_byte;
+  data[1] = magic;
+  data[2] = flags;
+  uint8_t *field = data + fixed_size;
+  if (has(COMPRESSED)) {
+    write_u16(field, uncompressed_size);
+    field += sizeof(uint16_t);
+  }
+  if (has(ACK_REQUESTED)) {
+    write_u32(field, sequence);
+    field += sizeof(uint32_t);
+  }
+  if (has(TIMESTAMP)) {
+    write_u64(field, timestamp);
+    field += sizeof(uint64_t);
+  }
+  return header_size;
+}
+
+bool Ack::parse(const uint8_t *data, size_t size) {
+  if (size < serialized_size || data[0] != start_byte || data[1] != magic) {
+    return false;
+  }
+  flags = data[2];
+  sequence = read_u32(data + 3);
+  queue_depth = read_u16(data + 7);
+  credits = read_u16(data + 9);
+  return true;
+}
+
+size_t Ack::serialize(uint8_t *data, size_t size) const {
+  if (size < serialized_size) {
+    return 0;
+  }
+  data[0] = start_byte;
+  data[1] = magic;
+  data[2] = flags;
+  write_u32(data + 3, sequence);
+  write_u16(data + 7, queue_depth);
+  write_u16(data + 9, credits);
+  return serialized_size;
+}
@@ -0,0 +1,61 @@
+#include "series_record.hpp"
+
+#include <algorithm>
+
+static size_t name_size(const std::string &name) {
+  return std::min(name.size(), SeriesRecord::max_name_size);
+}
+
+size_t SeriesRecord::header_size(const std::string &name) {
+  return 1 + name_size(name) + sizeof(uint16_t);
+}
+
+size_t SeriesRecord::serialize(const std::string &name, const int32_t *samples, size_t count,
+                               uint8_t *data, size_t size, size_t &record_size) {
+  size_t header = header_size(name);
+  if (size < header) {
+    record_size = 0;
+    return 0;
+  }
+  count = std::min({count, (size - header) / sizeof(int32_t), size_t{UINT16_MAX}});
+  uint8_t *p = data;
+  *p++ = name_size(name);
+  p = std::copy_n(name.data(), name_size(name), p);
+  *p++ = count & 0xff;
+  *p++ = count >> 8;
+  for (size_t i = 0; i < count; i++) {
+    auto value = static_cast<uint32_t>(samples[i]);
+    for (int shift = 0; shift < 32; shift += 8) {
+      *p++ = (value >> shift) & 0xff;
+    }
+  }
+  record_size = p - data;
+  return count;
+}
+
+size_t SeriesRecord::parse(const uint8_t *data, size_t size, std::string &name,
+                           std::vector<int32_t> &samples) {
+  if (size < 1 || size < 1 + data[0] + sizeof(uint16_t)) {
+    return 0;
+  }
+  const uint8_t *p = data;
+  size_t length = *p++;
+  name.assign(reinterpret_cast<const char *>(p), length);
+  p += length;
+  size_t count = p[0] | (p[1] << 8);
+  p += sizeof(uint16_t);
+  size_t record_size = (p - data) + count * sizeof(int32_t);
+  if (size < record_size) {
+    return 0;
+  }
+  samples.clear();
+  samples.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+      value |= static_cast<uint32_t>(*p++) << shift;
+    }
+    samples.push_back(static_cast<int32_t>(value));
+  }
+  return record_size;
+}
@@ -1,9 +1,19 @@
 #include <sdkconfig.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cstring>
 #include <thread>
+#include <vector>
 
+#include <esp_pthread.h>
+#include <esp_timer.h>
+#include <esp_wifi.h>
+#include <lwip/inet.h>
 #include <mdns.h>
+#include <nvs.h>
 
 #if CONFIG_HARDWARE_WROVER_KIT
 #include "wrover-kit.hpp"
@@ -27,8 +37,14 @@ using Hal = espp::TDeck;
 
 #include "button.hpp"
 #include "cli.hpp"
+#include "exporter.hpp"
 #include "gui.hpp"
 #include "logger.hpp"
+#include "lz4.hpp"
+#if CONFIG_DEBUG_DISPLAY_MIRROR
+#include "mirror.hpp"
+#endif
+#include "packet.hpp"
 #include "task.hpp"
 #include "tcp_socket.hpp"
 #include "udp_socket.hpp"
@@ -41,52 +57,159 @@ static espp::Logger logger({.tag = "WirelessDebugDisplay", .level = espp::Logger
 
 static std::recursive_mutex gui_mutex;
 static std::shared_ptr<Gui> gui;
+static std::unique_ptr<Exporter> exporter;
+#if CONFIG_DEBUG_DISPLAY_MIRROR
+static std::unique_ptr<Mirror> mirror;
+#endif
 
 static constexpr size_t server_port = CONFIG_DEBUG_SERVER_PORT;
 static std::recursive_mutex server_mutex;
-static std::unique_ptr<espp::Task> start_server_task;
+static std::unique_ptr<espp::Task> start_mdns_task;
 static std::string server_address = "";
 static std::shared_ptr<espp::UdpSocket> server_socket;
+static std::string multicast_group = ""; ///< Empty unless the server joined a multicast group
+static std::atomic<size_t> num_packets_received{0};
+static std::atomic<size_t> num_bytes_received{0};
+static std::atomic<size_t> num_payload_bytes_received{0}; ///< After decompression
+static std::atomic<size_t> num_invalid_packets{0};
+static std::atomic<size_t> num_dropped_packets{0}; ///< Because the gui couldn't keep up
+static std::atomic<size_t> num_acks_sent{0};
+// the counters when the `counters` command last ran (or the server started)
+static std::chrono::steady_clock::time_point counters_last_time{};
+static size_t counters_last_packets = 0;
+static size_t counters_last_bytes = 0;
+
+static std::shared_ptr<espp::WifiSta> wifi_sta; ///< Guarded by server_mutex until wifi init joins
+static std::atomic<bool> has_got_ip{false};
+
+// The time (since boot) at which each phase of the boot started and ended, so
+// that we can track the time it takes to be ready / to get the first packet.
+struct BootPhase {
+  std::string name;
+  int64_t start_us;
+  int64_t end_us;
+};
+static std::mutex boot_phases_mutex;
+static std::vector<BootPhase> boot_phases;
+
+#if CONFIG_ESP32_WIFI_NVS_ENABLED
+// The access point we last connected to, which lets us skip the WiFi scan when
+// reconnecting to it.
+struct WifiApCache {
+  char ssid[33];
+  uint8_t bssid[6];
+  uint8_t channel;
+};
+static constexpr const char *wifi_ap_cache_namespace = "debug_display";
+static constexpr const char *wifi_ap_cache_key = "wifi_ap";
+static std::atomic<bool> using_wifi_ap_cache{false};
+
+bool load_wifi_ap_cache(WifiApCache &cache);
+void save_wifi_ap_cache();
+void stop_using_wifi_ap_cache();
+#endif
 
-static std::shared_ptr<espp::WifiSta> wifi_sta;
+void add_boot_phase(const std::string &name, int64_t start_us);
+void add_boot_milestone(const std::string &name);
+std::string format_boot_phases();
 
-bool start_server(std::mutex &m, std::condition_variable &cv, bool &task_notified);
+void init_wifi();
+void update_info();
+bool start_server();
+bool start_mdns(std::mutex &m, std::condition_variable &cv, bool &task_notified);
 std::optional<std::vector<uint8_t>> on_data_received(const std::vector<uint8_t> &data,
                                                      const espp::Socket::Info &sender_info);
+void on_export_command(const std::string &args, const std::string &sender);
+#if CONFIG_DEBUG_DISPLAY_MIRROR
+void on_mirror_command(const std::string &args, const std::string &sender);
+#endif
 
 extern "C" void app_main(void) {
   logger.info("Bootup");
+  int64_t start_us = esp_timer_get_time();
 
 #if CONFIG_ESP32_WIFI_NVS_ENABLED
   // initialize NVS, needed for WiFi
   std::error_code ec;
   espp::Nvs nvs;
   nvs.init(ec);
+  add_boot_phase("nvs", start_us);
 #endif
 
+  // initialize WiFi in parallel with the display and the gui, since it mostly
+  // waits on the radio
+  esp_pthread_cfg_t previous_pthread_config;
+  if (esp_pthread_get_cfg(&previous_pthread_config) != ESP_OK) {
+    previous_pthread_config = esp_pthread_get_default_config();
+  }
+  auto pthread_config = esp_pthread_get_default_config();
+  pthread_config.thread_name = "WiFi Init";
+  pthread_config.stack_size = 6 * 1024;
+  esp_pthread_set_cfg(&pthread_config);
+  std::thread wifi_init_thread(init_wifi);
+  // don't let later threads inherit the name and stack size
+  esp_pthread_set_cfg(&previous_pthread_config);
+
   // hardware specific configuration
   auto &hal = Hal::get();
 
   hal.set_log_level(espp::Logger::Verbosity::INFO);
 
+  start_us = esp_timer_get_time();
   if (!hal.initialize_lcd()) {
     logger.error("Could not initialize LCD");
+    // a joinable thread would terminate (and reboot) when it goes out of scope
+    wifi_init_thread.join();
     return;
   }
+  add_boot_phase("lcd", start_us);
   // initialize the display, using a pixel buffer of 50 lines
   static constexpr size_t pixel_buffer_size = hal.lcd_width() * 50;
+  start_us = esp_timer_get_time();
   if (!hal.initialize_display(pixel_buffer_size)) {
     logger.error("Could not initialize display");
+    wifi_init_thread.join();
     return;
   }
+  add_boot_phase("display", start_us);
 
   auto display = hal.display();
 
+  // create the exporter, which streams the data held by the gui back out
+  exporter = std::make_unique<Exporter>(Exporter::Config{
+      .get_plot_samples =
+          []() {
+            std::lock_guard<std::recursive_mutex> lock(gui_mutex);
+            return gui ? gui->get_plot_samples() : Exporter::PlotSamples{};
+          },
+      .get_logs =
+          [](size_t offset, size_t max_size) {
+            std::lock_guard<std::recursive_mutex> lock(gui_mutex);
+            return gui ? gui->get_logs(offset, max_size) : std::string{};
+          },
+      .log_level = espp::Logger::Verbosity::INFO});
+
+#if CONFIG_DEBUG_DISPLAY_MIRROR
+  // the mirror hooks into LVGL, so it has to be created before the gui task
+  mirror = std::make_unique<Mirror>(Mirror::Config{.display = lv_display_get_default(),
+                                                   .log_level = espp::Logger::Verbosity::INFO});
+#endif
+
   // create the gui
-  gui = std::make_shared<Gui>(
-      Gui::Config{.display = display, .log_level = espp::Logger::Verbosity::DEBUG});
+  start_us = esp_timer_get_time();
+  {
+    std::lock_guard<std::recursive_mutex> lock(gui_mutex);
+    gui = std::make_shared<Gui>(Gui::Config{.display = display,
+                                            .on_export = on_export_command,
+#if CONFIG_DEBUG_DISPLAY_MIRROR
+                                            .on_mirror = on_mirror_command,
+#endif
+                                            .log_level = espp::Logger::Verbosity::DEBUG});
+  }
+  add_boot_phase("gui", start_us);
 
   // initialize the input system
+  start_us = esp_timer_get_time();
 #if !HAS_TOUCH
   espp::Button button({
       .interrupt_config =
@@ -107,52 +230,26 @@ extern "C" void app_main(void) {
 #else
   if (!hal.initialize_touch()) {
     logger.error("Could not initialize touch");
+    wifi_init_thread.join();
     return;
   }
 #endif
+  add_boot_phase("input", start_us);
 
-  // initialize WiFi
-  logger.info("Initializing WiFi");
-  wifi_sta = std::make_shared<espp::WifiSta>(espp::WifiSta::Config{
-      .ssid = CONFIG_ESP_WIFI_SSID,
-      .password = CONFIG_ESP_WIFI_PASSWORD,
-      .num_connect_retries = CONFIG_ESP_MAXIMUM_RETRY,
-      .on_connected = []() { logger.info("WiFi connected, waiting for IP"); },
-      .on_disconnected =
-          []() {
-            logger.info("WiFi disconnected, stopping server task and freeing resources");
-            std::lock_guard<std::recursive_mutex> lock(server_mutex);
-            // stop the server task
-            start_server_task.reset();
-            logger.info("server task stopped");
-            // free the medns resources
-            mdns_free();
-            logger.info("mdns resources freed");
-            // delete the socket
-            server_socket.reset();
-            logger.info("Socket resources freed");
-          },
-      .on_got_ip =
-          [](ip_event_got_ip_t *eventdata) {
-            server_address = fmt::format("{}.{}.{}.{}", IP2STR(&eventdata->ip_info.ip));
-            logger.info("got IP: {}.{}.{}.{}", IP2STR(&eventdata->ip_info.ip));
-            // update the info page
-            {
-              std::lock_guard<std::recursive_mutex> lock(gui_mutex);
-              gui->clear_info();
-              gui->add_info(std::string("#FF0000 WiFi: #") + wifi_sta->get_ssid());
-              gui->add_info(std::string("#00FF00 IP: #") + server_address + ":" +
-                            std::to_string(server_port));
-            }
-            // start the server task
-            {
-              std::lock_guard<std::recursive_mutex> lock(server_mutex);
-              start_server_task = espp::Task::make_unique(
-                  espp::Task::Config{.callback = start_server,
-                                     .task_config = {.name = "Start Server Task", .priority = 10}});
-              start_server_task->start();
-            }
-          }});
+  wifi_init_thread.join();
+  // we may have already gotten an IP while we were creating the gui
+  update_info();
+
+  // start the server now, rather than when we get an IP, so that it is ready
+  // to receive as soon as we have one
+  start_us = esp_timer_get_time();
+  if (!start_server()) {
+    logger.error("Could not start server");
+    return;
+  }
+  add_boot_phase("server", start_us);
+  add_boot_milestone("ready");
+  logger.info("Boot phases:\n{}", format_boot_phases());
 
   espp::WifiStaMenu sta_menu(*wifi_sta);
   auto root_menu = sta_menu.get();
@@ -164,6 +261,11 @@ extern "C" void app_main(void) {
       },
       "Display minimum free memory.");
 
+  // add a command to print the boot timing
+  root_menu->Insert(
+      "boot_times", [](std::ostream &out) { out << format_boot_phases(); },
+      "Display the time spent in each phase of the boot.");
+
   // add a command to switch tabs
   root_menu->Insert(
       "switch_tab",
@@ -204,11 +306,155 @@ extern "C" void app_main(void) {
       },
       "Clear the Log display.");
 
+  // add a command to export the plots or logs over the network
+  root_menu->Insert(
+      "export",
+      [](std::ostream &out, const std::string &content, const std::string &format,
+         const std::string &ip, const std::string &port, const std::string &transport) {
+        auto request = Exporter::parse_request(
+            fmt::format("{},{},{},{},{}", content, format, port, transport, ip), ip);
+        if (!request) {
+          out << "Invalid export, plots are csv or bin, logs are text.\n";
+          return;
+        }
+        if (!exporter->start(*request)) {
+          out << "An export is already running.\n";
+          return;
+        }
+        out << fmt::format("Exporting {} to {}:{}.\n", content, ip, port);
+      },
+      "Export the plots (csv or bin) or the logs (text) to ip:port over udp or tcp.",
+      {"plots|logs", "csv|bin|text", "ip", "port", "udp|tcp"});
+
+#if CONFIG_DEBUG_DISPLAY_MIRROR
+  // add commands to mirror the screen to a host
+  root_menu->Insert(
+      "mirror",
+      [](std::ostream &out, const std::string &ip, int port) {
+        if (port <= 0 || port > 65535) {
+          out << "Invalid port.\n";
+          return;
+        }
+        mirror->subscribe(ip, port);
+        out << fmt::format("Mirroring the screen to {}:{}.\n", ip, port);
+      },
+      "Mirror the screen to ip:port over udp.", {"ip", "port"});
+
+  root_menu->Insert(
+      "stop_mirror",
+      [](std::ostream &out) {
+        mirror->unsubscribe();
+        out << "Mirroring stopped.\n";
+      },
+      "Stop mirroring the screen.");
+
+#endif
+  // add a command to print the statistics of each plot
+  root_menu->Insert(
+      "stats",
+      [](std::ostream &out) {
+        std::lock_guard<std::recursive_mutex> lock(gui_mutex);
+        auto plot_stats = gui->get_plot_stats();
+        if (plot_stats.empty()) {
+          out << "No plots.\n";
+          return;
+        }
+        out << fmt::format("{:<16} {:>8} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10} {:>8}\n",
+                           "name", "count", "last", "min", "max", "mean", "stddev", "p50", "p99",
+                           "rate_hz");
+        for (const auto &[name, stats] : plot_stats) {
+          out << fmt::format(
+              "{:<16} {:>8} {:>10.4g} {:>10.4g} {:>10.4g} {:>10.4g} {:>10.4g} {:>10.4g} {:>10.4g} "
+              "{:>8.1f}\n",
+              name, stats.count(), stats.last(), stats.min(), stats.max(), stats.mean(),
+              stats.stddev(), stats.p50(), stats.p99(), stats.rate());
+        }
+      },
+      "Display the running statistics of each plot.");
+
+  // add a command to print the latency of the data, from sender to screen
+  root_menu->Insert(
+      "latency",
+      [](std::ostream &out) {
+        std::lock_guard<std::recursive_mutex> lock(gui_mutex);
+        auto latency = gui->get_latency();
+        out << fmt::format("{:<10} {:>8} {:>10} {:>10} {:>10} {:>10} {:>10}\n", "stage", "count",
+                           "min_ms", "mean_ms", "p50_ms", "p99_ms", "max_ms");
+        for (int i = 0; i < LatencyTracker::STAGE_COUNT; i++) {
+          auto stage = static_cast<LatencyTracker::Stage>(i);
+          const auto &histogram = latency.get(stage);
+          out << fmt::format("{:<10} {:>8} {:>10.2f} {:>10.2f} {:>10.2f} {:>10.2f} {:>10.2f}\n",
+                             LatencyTracker::stage_name(stage), histogram.count(),
+                             histogram.min_us() / 1000.0f, histogram.mean_us() / 1000.0f,
+                             histogram.percentile_us(0.5f) / 1000.0f,
+                             histogram.percentile_us(0.99f) / 1000.0f,
+                             histogram.max_us() / 1000.0f);
+        }
+        for (const auto &[sender, offset_us] : latency.get_clock_offsets_us()) {
+          out << fmt::format("Clock offset from {}: {} us\n", sender, offset_us);
+        }
+        if (latency.num_untracked()) {
+          out << fmt::format("{} packets not traced to the screen\n", latency.num_untracked());
+        }
+        out << "Network and end-to-end latencies are only measured for timestamped packets, and\n"
+               "are relative to the fastest packet of each sender in the last 10-20 s.\n";
+      },
+      "Display the latency of each stage, from the sender to the screen.");
+
+  root_menu->Insert(
+      "reset_latency",
+      [](std::ostream &out) {
+        std::lock_guard<std::recursive_mutex> lock(gui_mutex);
+        gui->reset_latency();
+        out << "Latency histograms reset.\n";
+      },
+      "Reset the latency histograms and clock offsets.");
+
+  // add a command to print the server's receive counters
+  root_menu->Insert(
+      "counters",
+      [](std::ostream &out) {
+        // rates are computed since the last time this command was run
+        auto now = std::chrono::steady_clock::now();
+        float elapsed = std::chrono::duration<float>(now - counters_last_time).count();
+        size_t packets = num_packets_received;
+        size_t bytes = num_bytes_received;
+        out << fmt::format("Received {} packets ({} bytes, {} bytes decompressed), {} invalid\n",
+                           packets, bytes, num_payload_bytes_received.load(),
+                           num_invalid_packets.load());
+        out << fmt::format("Dropped {} packets (queue full), sent {} acks\n",
+                           num_dropped_packets.load(), num_acks_sent.load());
+#if CONFIG_DEBUG_DISPLAY_MIRROR
+        out << fmt::format("Mirror: {}\n", mirror->get_stats());
+#endif
+        {
+          std::lock_guard<std::recursive_mutex> lock(gui_mutex);
+          if (gui) {
+            out << fmt::format("Queue: {} / {} packets\n", gui->get_data_queue_size(),
+                               gui->get_data_queue_capacity());
+          }
+        }
+        if (elapsed < 0.1f) {
+          // too short for the rates to mean anything
+          return;
+        }
+        out << fmt::format("Over the last {:.1f} s: {:.1f} packets/s, {:.1f} kB/s\n", elapsed,
+                           (packets - counters_last_packets) / elapsed,
+                           (bytes - counters_last_bytes) / elapsed / 1000.0f);
+        counters_last_time = now;
+        counters_last_packets = packets;
+        counters_last_bytes = bytes;
+      },
+      "Display the number and rate of packets received by the server.");
+
   // add a command to push data into the display
   root_menu->Insert("push_data",
                     [](std::ostream &out, const std::string &data) {
                       std::lock_guard<std::recursive_mutex> lock(gui_mutex);
-                      gui->push_data(data);
+                      if (!gui->push_data(data)) {
+                        out << "Queue full, data dropped.\n";
+                        return;
+                      }
                       gui->handle_data();
                       out << "Data pushed to display.\n";
                     },
@@ -232,11 +478,206 @@ extern "C" void app_main(void) {
   input.Start();
 }
 
-bool start_server(std::mutex &m,               // cppcheck-suppress constParameterCallback
-                  std::condition_variable &cv, // cppcheck-suppress constParameterCallback
-                  bool &task_notified) {       // cppcheck-suppress constParameterCallback
+void add_boot_phase(const std::string &name, int64_t start_us) {
+  // phases are only recorded the first time, e.g. mDNS restarts on every
+  // reconnect but only the first start is part of the boot
+  std::lock_guard<std::mutex> lock(boot_phases_mutex);
+  for (const auto &phase : boot_phases) {
+    if (phase.name == name) {
+      return;
+    }
+  }
+  boot_phases.push_back({name, start_us, esp_timer_get_time()});
+}
+
+void add_boot_milestone(const std::string &name) {
+  // milestones are measured from boot and only recorded the first time
+  std::lock_guard<std::mutex> lock(boot_phases_mutex);
+  for (const auto &phase : boot_phases) {
+    if (phase.name == name) {
+      return;
+    }
+  }
+  boot_phases.push_back({name, 0, esp_timer_get_time()});
+}
+
+std::string format_boot_phases() {
+  std::lock_guard<std::mutex> lock(boot_phases_mutex);
+  std::string text =
+      fmt::format("{:<16} {:>10} {:>10} {:>11}\n", "phase", "start_ms", "end_ms", "duration_ms");
+  for (const auto &phase : boot_phases) {
+    text += fmt::format("{:<16} {:>10.1f} {:>10.1f} {:>11.1f}\n", phase.name,
+                        phase.start_us / 1000.0f, phase.end_us / 1000.0f,
+                        (phase.end_us - phase.start_us) / 1000.0f);
+  }
+  return text;
+}
+
+void init_wifi() {
+  int64_t start_us = esp_timer_get_time();
+  logger.info("Initializing WiFi");
+  espp::WifiSta::Config wifi_config{
+      .ssid = CONFIG_ESP_WIFI_SSID,
+      .password = CONFIG_ESP_WIFI_PASSWORD,
+      .num_connect_retries = CONFIG_ESP_MAXIMUM_RETRY,
+      .on_connected =
+          []() {
+            add_boot_milestone("wifi connected");
+            logger.info("WiFi connected, waiting for IP");
+          },
+      .on_disconnected =
+          []() {
+#if CONFIG_ESP32_WIFI_NVS_ENABLED
+            // if we never connected using the cached access point, it may
+            // have moved, so fall back to a full scan
+            if (using_wifi_ap_cache && !has_got_ip) {
+              stop_using_wifi_ap_cache();
+            }
+#endif
+            logger.info("WiFi disconnected, stopping mDNS");
+            std::lock_guard<std::recursive_mutex> lock(server_mutex);
+            // stop the mdns task
+            start_mdns_task.reset();
+            // free the medns resources
+            mdns_free();
+            logger.info("mdns resources freed");
+          },
+      .on_got_ip =
+          [](ip_event_got_ip_t *eventdata) {
+            add_boot_milestone("got ip");
+            has_got_ip = true;
+            {
+              std::lock_guard<std::recursive_mutex> lock(server_mutex);
+              server_address = fmt::format("{}.{}.{}.{}", IP2STR(&eventdata->ip_info.ip));
+            }
+            logger.info("got IP: {}.{}.{}.{}", IP2STR(&eventdata->ip_info.ip));
+            // the server is already listening, so update the info page and
+            // start advertising it
+            update_info();
+            {
+              std::lock_guard<std::recursive_mutex> lock(server_mutex);
+              start_mdns_task = espp::Task::make_unique(
+                  espp::Task::Config{.callback = start_mdns,
+                                     .task_config = {.name = "Start mDNS Task", .priority = 10}});
+              start_mdns_task->start();
+            }
+#if CONFIG_ESP32_WIFI_NVS_ENABLED
+            save_wifi_ap_cache();
+#endif
+          }};
+
+#if CONFIG_ESP32_WIFI_NVS_ENABLED
+  // if we know the channel and BSSID of the access point, connect to it
+  // directly instead of scanning for it
+  WifiApCache cache;
+  if (load_wifi_ap_cache(cache) && !wifi_config.ssid.empty() && wifi_config.ssid == cache.ssid) {
+    logger.info("Using cached access point (channel {})", cache.channel);
+    wifi_config.channel = cache.channel;
+    wifi_config.set_ap_mac = true;
+    memcpy(wifi_config.ap_mac, cache.bssid, sizeof(cache.bssid));
+    using_wifi_ap_cache = true;
+  }
+#endif
+
+  // the IP may arrive (and update_info read wifi_sta) before this returns
+  auto sta = std::make_shared<espp::WifiSta>(wifi_config);
+  {
+    std::lock_guard<std::recursive_mutex> lock(server_mutex);
+    wifi_sta = sta;
+  }
+  add_boot_phase("wifi init", start_us);
+}
+
+#if CONFIG_ESP32_WIFI_NVS_ENABLED
+bool load_wifi_ap_cache(WifiApCache &cache) {
+  nvs_handle_t handle;
+  if (nvs_open(wifi_ap_cache_namespace, NVS_READONLY, &handle) != ESP_OK) {
+    return false;
+  }
+  size_t size = sizeof(cache);
+  auto err = nvs_get_blob(handle, wifi_ap_cache_key, &cache, &size);
+  nvs_close(handle);
+  if (err != ESP_OK || size != sizeof(cache)) {
+    return false;
+  }
+  cache.ssid[sizeof(cache.ssid) - 1] = '\0';
+  return true;
+}
+
+void save_wifi_ap_cache() {
+  wifi_ap_record_t ap_info;
+  if (esp_wifi_sta_get_ap_info(&ap_info) != ESP_OK) {
+    return;
+  }
+  WifiApCache cache{};
+  strncpy(cache.ssid, reinterpret_cast<const char *>(ap_info.ssid), sizeof(cache.ssid) - 1);
+  memcpy(cache.bssid, ap_info.bssid, sizeof(cache.bssid));
+  cache.channel = ap_info.primary;
+  // only write to flash if the access point changed
+  WifiApCache saved;
+  if (load_wifi_ap_cache(saved) && memcmp(&saved, &cache, sizeof(cache)) == 0) {
+    return;
+  }
+  nvs_handle_t handle;
+  if (nvs_open(wifi_ap_cache_namespace, NVS_READWRITE, &handle) != ESP_OK) {
+    return;
+  }
+  if (nvs_set_blob(handle, wifi_ap_cache_key, &cache, sizeof(cache)) == ESP_OK) {
+    nvs_commit(handle);
+    logger.info("Cached access point (channel {})", cache.channel);
+  }
+  nvs_close(handle);
+}
+
+void stop_using_wifi_ap_cache() {
+  logger.warn("Could not connect to cached access point, scanning instead");
+  using_wifi_ap_cache = false;
+  // forget the access point for the remaining retries...
+  wifi_config_t config;
+  if (esp_wifi_get_config(WIFI_IF_STA, &config) == ESP_OK) {
+    config.sta.bssid_set = false;
+    config.sta.channel = 0;
+    esp_wifi_set_config(WIFI_IF_STA, &config);
+  }
+  // ...and for the next boot
+  nvs_handle_t handle;
+  if (nvs_open(wifi_ap_cache_namespace, NVS_READWRITE, &handle) == ESP_OK) {
+    nvs_erase_key(handle, wifi_ap_cache_key);
+    nvs_commit(handle);
+    nvs_close(handle);
+  }
+}
+#endif
+
+void update_info() {
+  std::string address;
+  std::shared_ptr<espp::WifiSta> sta;
+  {
+    std::lock_guard<std::recursive_mutex> lock(server_mutex);
+    address = server_address;
+    sta = wifi_sta;
+  }
+  std::lock_guard<std::recursive_mutex> lock(gui_mutex);
+  if (!gui || address.empty() || !sta) {
+    // we'll be called again once we have all of these
+    return;
+  }
+  gui->clear_info();
+  gui->add_info(std::string("#FF0000 WiFi: #") + sta->get_ssid());
+  gui->add_info(std::string("#00FF00 IP: #") + address + ":" + std::to_string(server_port));
+  if (!multicast_group.empty()) {
+    gui->add_info(std::string("#0000FF Multicast: #") + multicast_group + ":" +
+                  std::to_string(server_port));
+  }
+}
+
+bool start_server() {
+  // the first `counters` command reports the rates since now
+  counters_last_time = std::chrono::steady_clock::now();
+  counters_last_packets = num_packets_received;
+  counters_last_bytes = num_bytes_received;
   // create the debug display socket
-  logger.info("Creating debug server at {}:{}", server_address, server_port);
+  logger.info("Creating debug server on port {}", server_port);
   // create the socket
   server_socket = std::make_shared<espp::UdpSocket>(
       espp::UdpSocket::Config{.log_level = espp::Logger::Verbosity::WARN});
@@ -249,14 +690,34 @@ bool start_server(std::mutex &m,               // cppcheck-suppress constParamet
       .buffer_size = 1024,
       .on_receive_callback = on_data_received,
   };
+#if CONFIG_DEBUG_SERVER_MULTICAST
+  // the same socket receives both unicast and multicast data on the port
+  in_addr group;
+  if (inet_pton(AF_INET, CONFIG_DEBUG_SERVER_MULTICAST_GROUP, &group) == 1 &&
+      IN_MULTICAST(ntohl(group.s_addr))) {
+    multicast_group = CONFIG_DEBUG_SERVER_MULTICAST_GROUP;
+    server_config.is_multicast_endpoint = true;
+    server_config.multicast_group = multicast_group;
+    logger.info("Joining multicast group {}", multicast_group);
+  } else {
+    logger.error("Invalid multicast group '{}', only receiving unicast",
+                 CONFIG_DEBUG_SERVER_MULTICAST_GROUP);
+  }
+#endif
 
   // set a timeout on the socket, so that it doesn't block indefinitely. This is
   // required to allow us to gracefully shutdown the socket.
   server_socket->set_receive_timeout(1000ms);
 
-  // now actually start the socket receiving task
-  server_socket->start_receiving(server_task_config, server_config);
+  // now actually start the socket receiving task. The socket is bound to any
+  // address, so it keeps working across WiFi disconnects / IP changes.
+  return server_socket->start_receiving(server_task_config, server_config);
+}
 
+bool start_mdns(std::mutex &m,               // cppcheck-suppress constParameterCallback
+                std::condition_variable &cv, // cppcheck-suppress constParameterCallback
+                bool &task_notified) {       // cppcheck-suppress constParameterCallback
+  int64_t start_us = esp_timer_get_time();
   // initialize mDNS, so that other embedded devices on the network can find us
   // without having to be hardcoded / configured with our IP address and port
   logger.info("Initializing mDNS");
@@ -280,24 +741,124 @@ bool start_server(std::mutex &m,               // cppcheck-suppress constParamet
     logger.error("Could not set mDNS instance name: {}", err);
     return true; // stop the task
   }
-  err = mdns_service_add("Wireless Debug Display", "_debugdisplay", "_udp", server_port, NULL, 0);
+  // let senders find the multicast group as well, so they can send once to all
+  // of the displays
+  std::vector<mdns_txt_item_t> txt;
+  if (!multicast_group.empty()) {
+    txt.push_back({.key = "multicast", .value = multicast_group.c_str()});
+  }
+  err = mdns_service_add("Wireless Debug Display", "_debugdisplay", "_udp", server_port,
+                         txt.data(), txt.size());
   if (err != ESP_OK) {
     logger.error("Could not add mDNS service: {}", err);
     return true; // stop the task
   }
   logger.info("mDNS initialized");
+  add_boot_phase("mdns", start_us);
 
   return true; // stop the task
 }
 
 std::optional<std::vector<uint8_t>> on_data_received(const std::vector<uint8_t> &data,
                                                      const espp::Socket::Info &sender_info) {
-  std::string data_str(data.begin(), data.end());
-  fmt::print("Server received: '{}'\n"
-             "    from source: {}\n",
-             data_str, sender_info);
-  std::lock_guard<std::recursive_mutex> lock(gui_mutex);
-  gui->push_data(data_str);
-  gui->handle_data();
-  return std::nullopt;
+  // the start of the packet's trace through the display
+  LatencyTracker::Trace trace{.received = LatencyTracker::Clock::now()};
+  num_packets_received++;
+  num_bytes_received += data.size();
+  std::string data_str;
+  PacketHeader header;
+  if (PacketHeader::is_binary(data.data(), data.size())) {
+    // this callback only runs in the server task, so the buffer can be reused
+    static std::array<uint8_t, PacketHeader::max_uncompressed_size> payload;
+    size_t header_size = header.parse(data.data(), data.size());
+    size_t payload_size = 0;
+    if (header_size == 0) {
+      // leave payload_size at 0, it is invalid
+    } else if (header.has(PacketHeader::COMPRESSED)) {
+      payload_size = Lz4::decompress(data.data() + header_size, data.size() - header_size,
+                                     payload.data(), payload.size());
+      if (payload_size != header.uncompressed_size) {
+        payload_size = 0;
+      }
+    } else {
+      payload_size = std::min(data.size() - header_size, payload.size());
+      memcpy(payload.data(), data.data() + header_size, payload_size);
+    }
+    if (payload_size == 0) {
+      num_invalid_packets++;
+      logger.warn("Dropping invalid packet ({} bytes) from {}", data.size(), sender_info);
+      return std::nullopt;
+    }
+    data_str.assign(payload.begin(), payload.begin() + payload_size);
+    if (header.has(PacketHeader::TIMESTAMP)) {
+      trace.sender_time_us = header.timestamp;
+    }
+  } else {
+    data_str.assign(data.begin(), data.end());
+  }
+  num_payload_bytes_received += data_str.size();
+  // NOTE: printing every packet over the console quickly becomes the
+  // bottleneck, so only do it when debugging
+  logger.debug("Server received: '{}'\n"
+               "    from source: {}",
+               data_str, sender_info);
+  if (num_packets_received == 1) {
+    add_boot_milestone("first packet");
+  }
+  // the gui task parses the data, so that receiving never waits on drawing
+  bool queued = false;
+  size_t queue_depth = 0;
+  size_t queue_capacity = 0;
+  {
+    std::lock_guard<std::recursive_mutex> lock(gui_mutex);
+    if (gui) {
+      queued = gui->push_data(data_str, sender_info.address, trace);
+      queue_depth = gui->get_data_queue_size();
+      queue_capacity = gui->get_data_queue_capacity();
+    }
+  }
+  if (!queued) {
+    num_dropped_packets++;
+  }
+  if (!header.has(PacketHeader::ACK_REQUESTED)) {
+    return std::nullopt;
+  }
+  // tell the sender how many more packets we can take, so it can pace itself
+  Ack ack;
+  ack.flags = queued ? 0 : Ack::DROPPED;
+  ack.sequence = header.sequence;
+  ack.queue_depth = queue_depth;
+  ack.credits = queue_capacity - queue_depth;
+  num_acks_sent++;
+  std::vector<uint8_t> response(Ack::serialized_size);
+  ack.serialize(response.data(), response.size());
+  return response;
+}
+
+void on_export_command(const std::string &args, const std::string &sender) {
+  // called from the gui task, so only start the export here
+  auto request = Exporter::parse_request(args, sender);
+  if (!request) {
+    logger.warn("Invalid export command '{}'", args);
+    return;
+  }
+  exporter->start(*request);
+}
+
+#if CONFIG_DEBUG_DISPLAY_MIRROR
+void on_mirror_command(const std::string &args, const std::string &sender) {
+  // "off" or "<port>[,<ip>]", where the ip defaults to the sender
+  if (args == "off") {
+    mirror->unsubscribe();
+    return;
+  }
+  auto separator = args.find(',');
+  int port = std::atoi(args.substr(0, separator).c_str());
+  std::string ip = separator == std::string::npos ? sender : args.substr(separator + 1);
+  if (port <= 0 || port > 65535 || ip.empty()) {
+    logger.warn("Invalid mirror command '{}'", args);
+    return;
+  }
+  mirror->subscribe(ip, port);
 }
+#endif
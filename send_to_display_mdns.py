@@ -6,8 +6,9 @@ import argparse
 from zeroconf import ServiceBrowser, ServiceListener, Zeroconf
 
 class MyListener(ServiceListener):
-    def __init__(self, message):
+    def __init__(self, message, multicast):
         self.message = message
+        self.multicast = multicast
         self.has_sent = False
 
     def update_service(self, zc: Zeroconf, type_: str, name: str) -> None:
@@ -21,6 +22,13 @@ class MyListener(ServiceListener):
         print(f"Service {name} added, service info: {info}")
         UDP_IP = socket.inet_ntoa(info.addresses[0])
         UDP_PORT = info.port
+        group = info.properties.get(b'multicast')
+        if self.multicast and not group:
+            print(f"Service {name} has not joined a multicast group")
+            return
+        if self.multicast:
+            # sent once, received by all of the displays in the group
+            UDP_IP = group.decode()
         sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM) # UDP
         sock.sendto(self.message.encode(), (UDP_IP, UDP_PORT))
         print(f"Sent to address: {UDP_IP}:{UDP_PORT}")
@@ -33,6 +41,8 @@ def main():
                        help='Messages to send to the display')
     group.add_argument('--file', dest='file', type=str,
                        help='the file to read the message from')
+    parser.add_argument('--multicast', action='store_true',
+                        help='send to the multicast group advertised by the display')
 
     args = parser.parse_args()
 
@@ -43,7 +53,7 @@ def main():
             MESSAGE = f.read()
 
     zeroconf = Zeroconf()
-    listener = MyListener(MESSAGE)
+    listener = MyListener(MESSAGE, args.multicast)
     browser = ServiceBrowser(zeroconf, "_debugdisplay._udp.local.", listener)
 
     print("Sending...\n")
@@ -0,0 +1,245 @@
+// Receiver for exports from the wireless debug display.
+//
+// Listens on a UDP or TCP port, asks the display to export its plots or logs
+// to it (optionally, with --ip), and writes what it receives to stdout (or a
+// file), decoding binary plot exports to CSV. It stops at the end of the
+// export: an empty datagram over UDP, or the connection closing over TCP.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "series_record.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  std::string content{"plots"}; ///< What to export: plots or logs
+  std::string format{"csv"};    ///< Format of the export: csv or bin (plots), text (logs)
+  size_t port{5556};            ///< Port to receive the export on
+  bool tcp{false};              ///< Receive over TCP instead of UDP
+  std::string ip;               ///< Address of the display to request the export from
+  size_t display_port{5555};    ///< Port of the display
+  std::string output;           ///< File to write to, stdout if empty
+  double timeout{5};            ///< Seconds to wait for data before giving up
+};
+
+static void print_usage(const char *name) {
+  std::printf(
+      "Usage: %s [options]\n"
+      "  --plots               receive the plots (default)\n"
+      "  --logs                receive the logs\n"
+      "  --bin                 request plots in binary instead of CSV (written as CSV)\n"
+      "  --port <port>         port to receive on (default 5556)\n"
+      "  --tcp                 receive over TCP instead of UDP\n"
+      "  --ip <address>        request the export from the display at this address,\n"
+      "                        instead of waiting for one requested elsewhere\n"
+      "  --display-port <port> port of the display (default 5555)\n"
+      "  --output <path>       write to this file instead of stdout\n"
+      "  --timeout <s>         seconds to wait for data (default 5)\n",
+      name);
+}
+
+static bool parse_options(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto value = [&]() -> const char * {
+      if (i + 1 >= argc) {
+        std::fprintf(stderr, "Missing value for %s\n", arg.c_str());
+        return nullptr;
+      }
+      return argv[++i];
+    };
+    const char *v = nullptr;
+    if (arg == "--plots") {
+      options.content = "plots";
+    } else if (arg == "--logs") {
+      options.content = "logs";
+    } else if (arg == "--bin") {
+      options.format = "bin";
+    } else if (arg == "--tcp") {
+      options.tcp = true;
+    } else if (arg == "--help" || arg == "-h") {
+      return false;
+    } else if ((v = value()) == nullptr) {
+      return false;
+    } else if (arg == "--port") {
+      options.port = std::atoi(v);
+    } else if (arg == "--ip") {
+      options.ip = v;
+    } else if (arg == "--display-port") {
+      options.display_port = std::atoi(v);
+    } else if (arg == "--output") {
+      options.output = v;
+    } else if (arg == "--timeout") {
+      options.timeout = std::atof(v);
+    } else {
+      std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+      return false;
+    }
+  }
+  if (options.content == "logs") {
+    options.format = "text";
+  }
+  return true;
+}
+
+/// Writes the received data, decoding binary records (which never span
+/// datagrams, but may span TCP reads) to CSV.
+class Writer {
+public:
+  Writer(FILE *file, bool is_binary)
+      : file_(file)
+      , is_binary_(is_binary) {
+    if (is_binary_) {
+      std::fprintf(file_, "series,index,value\n");
+    }
+  }
+
+  void write(const uint8_t *data, size_t size) {
+    if (!is_binary_) {
+      std::fwrite(data, 1, size, file_);
+      return;
+    }
+    pending_.insert(pending_.end(), data, data + size);
+    size_t offset = 0;
+    size_t record_size;
+    while ((record_size = SeriesRecord::parse(pending_.data() + offset, pending_.size() - offset,
+                                              name_, samples_)) > 0) {
+      // a series may be split over several records
+      if (name_ != last_name_) {
+        last_name_ = name_;
+        index_ = 0;
+      }
+      for (auto sample : samples_) {
+        std::fprintf(file_, "%s,%zu,%d\n", name_.c_str(), index_++, sample);
+      }
+      offset += record_size;
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + offset);
+  }
+
+  /// Whether all of the data could be decoded.
+  bool is_complete() const { return pending_.empty(); }
+
+private:
+  FILE *file_;
+  bool is_binary_;
+  std::vector<uint8_t> pending_;
+  std::string name_;
+  std::string last_name_;
+  std::vector<int32_t> samples_;
+  size_t index_{0};
+};
+
+static bool request_export(const Options &options) {
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(options.display_port);
+  if (inet_pton(AF_INET, options.ip.c_str(), &address.sin_addr) != 1) {
+    std::fprintf(stderr, "Invalid address %s\n", options.ip.c_str());
+    return false;
+  }
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock < 0) {
+    std::perror("socket");
+    return false;
+  }
+  // the display sends the export back to the address this comes from
+  std::string command = "+++EX:" + options.content + "," + options.format + "," +
+                        std::to_string(options.port) + "," + (options.tcp ? "tcp" : "udp");
+  bool sent = sendto(sock, command.data(), command.size(), 0,
+                     reinterpret_cast<const sockaddr *>(&address), sizeof(address)) >= 0;
+  if (!sent) {
+    std::perror("sendto");
+  }
+  close(sock);
+  return sent;
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parse_options(argc, argv, options)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  int sock = socket(AF_INET, options.tcp ? SOCK_STREAM : SOCK_DGRAM, 0);
+  if (sock < 0) {
+    std::perror("socket");
+    return 1;
+  }
+  int reuse = 1;
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(options.port);
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(sock, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0 ||
+      (options.tcp && listen(sock, 1) < 0)) {
+    std::perror("bind");
+    close(sock);
+    return 1;
+  }
+  if (!options.ip.empty() && !request_export(options)) {
+    close(sock);
+    return 1;
+  }
+
+  const int timeout_ms = options.timeout * 1000;
+  int data_sock = sock;
+  if (options.tcp) {
+    pollfd fd{.fd = sock, .events = POLLIN, .revents = 0};
+    if (poll(&fd, 1, timeout_ms) <= 0 || (data_sock = accept(sock, nullptr, nullptr)) < 0) {
+      std::fprintf(stderr, "No connection from the display\n");
+      close(sock);
+      return 1;
+    }
+  }
+
+  FILE *file = options.output.empty() ? stdout : std::fopen(options.output.c_str(), "w");
+  if (!file) {
+    std::perror("fopen");
+    return 1;
+  }
+  Writer writer(file, options.format == "bin");
+  std::vector<uint8_t> buffer(65536);
+  size_t total = 0;
+  bool is_done = false;
+  auto start = Clock::now();
+  while (!is_done) {
+    pollfd fd{.fd = data_sock, .events = POLLIN, .revents = 0};
+    if (poll(&fd, 1, timeout_ms) <= 0) {
+      std::fprintf(stderr, "Timed out waiting for data\n");
+      break;
+    }
+    ssize_t received = recv(data_sock, buffer.data(), buffer.size(), 0);
+    if (received < 0) {
+      std::perror("recv");
+      break;
+    }
+    // an empty datagram or a closed connection mark the end
+    is_done = received == 0;
+    writer.write(buffer.data(), received);
+    total += received;
+  }
+  double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+  std::fprintf(stderr, "Received %zu bytes in %.2f s%s\n", total, elapsed,
+               writer.is_complete() ? "" : " (the last record is incomplete)");
+  if (file != stdout) {
+    std::fclose(file);
+  }
+  if (data_sock != sock) {
+    close(data_sock);
+  }
+  close(sock);
+  return is_done && writer.is_complete() ? 0 : 1;
+}
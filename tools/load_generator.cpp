@@ -0,0 +1,778 @@
+// Load generator and replay tool for the wireless debug display.
+//
+// Sends lines (replayed from a file, or synthetic plot data) to the display at
+// a precise rate, packing as many lines as are due into each packet (up to the
+// configured packet size), and reports the rate which was actually achieved.
+// The --ip can also be a multicast group, which any number of displays (or
+// listeners, see --group) can receive at once. With --ack, the display acks
+// each packet with the number of packets it can still queue (credits), and
+// the senders never send more than that. With --compress, the lines are LZ4
+// compressed so that more of them fit into each packet. With --timestamp, each
+// packet carries its send time, so that the display can trace its latency to
+// the screen. It can also run as a sink (--listen, over UDP or --tcp), which is
+// useful for testing on localhost without a display.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "flow_control.hpp"
+#include "lz4.hpp"
+#include "packet.hpp"
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  std::string ip{"127.0.0.1"};       ///< Address of the display
+  uint16_t port{5555};               ///< Port of the display
+  std::string file{""};              ///< File to replay, if empty synthetic data is sent
+  size_t series{4};                  ///< Number of synthetic series per sender
+  std::string prefix{"load/s"};      ///< Name prefix of the synthetic series
+  double rate{1000};                 ///< Lines per second over all senders, 0 for unlimited
+  size_t packet_size{1024};          ///< Maximum payload size of each packet
+  size_t senders{1};                 ///< Number of concurrent senders (sockets)
+  double duration{10};               ///< Seconds to run for, 0 for no limit
+  uint64_t count{0};                 ///< Lines to send over all senders, 0 for no limit
+  bool tcp{false};                   ///< Use TCP instead of UDP
+  bool compress{false};              ///< LZ4 compress the lines of each packet
+  bool ack{false};                   ///< Request acks and only send when there are credits
+  bool timestamp{false};             ///< Stamp each packet with its send time
+  bool listen{false};                ///< Receive and count instead of sending
+  std::string group;                 ///< Multicast group to join when listening
+  std::string interface;             ///< Address of the interface to use for multicast
+};
+
+struct Counters {
+  std::atomic<uint64_t> lines{0};
+  std::atomic<uint64_t> packets{0};
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<uint64_t> text_bytes{0};    ///< Bytes of text sent, before compression
+  std::atomic<uint64_t> payload_bytes{0}; ///< Bytes of text sent, after compression
+  std::atomic<uint64_t> errors{0};
+  std::atomic<uint64_t> acks{0};     ///< Acks received (--ack)
+  std::atomic<uint64_t> dropped{0};  ///< Packets the display acked as dropped (--ack)
+  std::atomic<uint64_t> timeouts{0}; ///< Times the senders gave up waiting for an ack (--ack)
+};
+
+static std::atomic<bool> running{true};
+
+static void print_usage(const char *name) {
+  std::printf(
+      "Usage: %s [options]\n"
+      "  --ip <address>        address of the display (default 127.0.0.1)\n"
+      "  --port <port>         port of the display (default 5555)\n"
+      "  --file <path>         replay the lines of this file (looping)\n"
+      "  --series <n>          synthetic series per sender if no file (default 4)\n"
+      "  --prefix <name>       name prefix of the synthetic series (default load/s)\n"
+      "  --rate <lines/s>      total lines per second, 0 for unlimited (default 1000)\n"
+      "  --packet-size <bytes> maximum payload of each packet (default 1024)\n"
+      "  --senders <n>         number of concurrent senders (default 1)\n"
+      "  --duration <s>        seconds to run for, 0 for no limit (default 10)\n"
+      "  --count <lines>       total lines to send, 0 for no limit (default 0)\n"
+      "  --tcp                 send (or listen) over TCP instead of UDP\n"
+      "  --compress            LZ4 compress the lines of each packet (UDP only)\n"
+      "  --ack                 request acks and pace to the display's credits (UDP only)\n"
+      "  --timestamp           stamp each packet with its send time (UDP only)\n"
+      "  --listen              receive on --port and report the received rate\n"
+      "  --group <address>     multicast group to join when listening\n"
+      "  --interface <address> address of the interface used for multicast, e.g.\n"
+      "                        127.0.0.1 for testing on localhost (default any)\n",
+      name);
+}
+
+static bool parse_options(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto value = [&]() -> const char * {
+      if (i + 1 >= argc) {
+        std::fprintf(stderr, "Missing value for %s\n", arg.c_str());
+        return nullptr;
+      }
+      return argv[++i];
+    };
+    const char *v = nullptr;
+    if (arg == "--tcp") {
+      options.tcp = true;
+    } else if (arg == "--compress") {
+      options.compress = true;
+    } else if (arg == "--ack") {
+      options.ack = true;
+    } else if (arg == "--timestamp") {
+      options.timestamp = true;
+    } else if (arg == "--listen") {
+      options.listen = true;
+    } else if (arg == "--help" || arg == "-h") {
+      return false;
+    } else if ((v = value()) == nullptr) {
+      return false;
+    } else if (arg == "--ip") {
+      options.ip = v;
+    } else if (arg == "--port") {
+      options.port = std::atoi(v);
+    } else if (arg == "--file") {
+      options.file = v;
+    } else if (arg == "--series") {
+      options.series = std::max(1, std::atoi(v));
+    } else if (arg == "--prefix") {
+      options.prefix = v;
+    } else if (arg == "--rate") {
+      options.rate = std::max(0.0, std::atof(v));
+    } else if (arg == "--packet-size") {
+      options.packet_size = std::max(32, std::atoi(v));
+    } else if (arg == "--senders") {
+      options.senders = std::max(1, std::atoi(v));
+    } else if (arg == "--duration") {
+      options.duration = std::max(0.0, std::atof(v));
+    } else if (arg == "--count") {
+      options.count = std::strtoull(v, nullptr, 10);
+    } else if (arg == "--group") {
+      options.group = v;
+    } else if (arg == "--interface") {
+      options.interface = v;
+    } else {
+      std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+      return false;
+    }
+  }
+  if (options.tcp && !options.group.empty()) {
+    std::fprintf(stderr, "--group needs UDP, so it can't be used with --tcp\n");
+    return false;
+  }
+  if (options.tcp && (options.compress || options.ack || options.timestamp)) {
+    std::fprintf(stderr, "--compress, --ack and --timestamp need packets, so they can't be used "
+                         "with --tcp\n");
+    return false;
+  }
+  return true;
+}
+
+/// Parse address into in, returning false (with an error) if it is invalid.
+static bool parse_address(const std::string &address, in_addr &in) {
+  if (inet_pton(AF_INET, address.c_str(), &in) != 1) {
+    std::fprintf(stderr, "Invalid address %s\n", address.c_str());
+    return false;
+  }
+  return true;
+}
+
+/// Address of the interface to use for multicast, INADDR_ANY by default.
+static bool get_interface(const Options &options, in_addr &interface) {
+  if (options.interface.empty()) {
+    interface.s_addr = htonl(INADDR_ANY);
+    return true;
+  }
+  return parse_address(options.interface, interface);
+}
+
+/// Produces the lines to send, either from the replayed file or synthetic
+/// plot data for a number of series.
+class LineSource {
+public:
+  LineSource(const std::vector<std::string> &file_lines, const Options &options, size_t index)
+      : file_lines_(file_lines)
+      , options_(options)
+      , index_(index)
+      , position_(index)
+      , rng_(index) {
+    next();
+  }
+
+  const std::string &peek() const { return line_; }
+
+  void next() {
+    if (!file_lines_.empty()) {
+      line_ = file_lines_[position_++ % file_lines_.size()];
+      return;
+    }
+    // a noisy sine wave per series, each with a different period. Every
+    // sender has its own series so that their samples don't interleave.
+    size_t series = position_ % options_.series;
+    size_t sample = position_ / options_.series;
+    double period = 50.0 * (series + 1);
+    int value = static_cast<int>(1000 * std::sin(2 * M_PI * sample / period)) + noise_(rng_);
+    line_ = options_.prefix + std::to_string(index_ * options_.series + series) +
+            "::" + std::to_string(value);
+    position_++;
+  }
+
+private:
+  const std::vector<std::string> &file_lines_;
+  const Options &options_;
+  size_t index_;
+  size_t position_;
+  std::string line_;
+  std::mt19937 rng_;
+  std::uniform_int_distribution<int> noise_{-50, 50};
+};
+
+/// Packs lines into packets of at most packet_size bytes. If compressing,
+/// packets hold as many lines as still fit once compressed.
+class PacketBuilder {
+public:
+  explicit PacketBuilder(const Options &options)
+      : options_(options) {}
+
+  /// Build the next packet from at most max_lines lines, returning the number
+  /// of lines in it. The header (if it has any flags) is prepended to the
+  /// packet, with the COMPRESSED flag added if compressing (and if that makes
+  /// the text smaller).
+  size_t build(LineSource &source, uint64_t max_lines, PacketHeader header,
+               std::vector<uint8_t> &packet) {
+    if (options_.compress) {
+      header.flags |= PacketHeader::COMPRESSED;
+    }
+    const size_t text_limit = options_.compress ? PacketHeader::max_uncompressed_size
+                              : header.flags    ? options_.packet_size - header.size()
+                                                : options_.packet_size;
+    batch_.clear();
+    text_.clear();
+    while (batch_.size() < max_lines) {
+      if (pending_.empty()) {
+        pending_.push_back(source.peek());
+        source.next();
+      }
+      const auto &line = pending_.front();
+      size_t size = text_.empty() ? line.size() : text_.size() + 1 + line.size();
+      if (!text_.empty() && size > text_limit) {
+        break;
+      }
+      if (!text_.empty()) {
+        text_ += '\n';
+      }
+      text_ += line;
+      batch_.push_back(std::move(pending_.front()));
+      pending_.pop_front();
+    }
+    if (!options_.compress) {
+      write_text(header, packet);
+      return batch_.size();
+    }
+
+    while (true) {
+      header.uncompressed_size = text_.size();
+      packet.resize(options_.packet_size);
+      size_t header_size = header.serialize(packet.data(), packet.size());
+      size_t compressed_size =
+          header_size == 0 ? 0
+                           : Lz4::compress(reinterpret_cast<const uint8_t *>(text_.data()),
+                                           text_.size(), packet.data() + header_size,
+                                           packet.size() - header_size);
+      if (compressed_size > 0 && compressed_size >= text_.size()) {
+        // e.g. short lines, which LZ4 only makes bigger, so send them as is
+        // (they fit, since the compressed text did)
+        header.flags &= ~PacketHeader::COMPRESSED;
+        write_text(header, packet);
+        return batch_.size();
+      }
+      if (compressed_size > 0) {
+        packet.resize(header_size + compressed_size);
+        payload_size_ = compressed_size;
+        return batch_.size();
+      }
+      if (batch_.size() == 1) {
+        // a single line which doesn't fit even when compressed, so send it as is
+        header.flags &= ~PacketHeader::COMPRESSED;
+        write_text(header, packet);
+        return 1;
+      }
+      // too many lines, so keep the last quarter of them for the next packet
+      size_t num_dropped = std::max<size_t>(1, batch_.size() / 4);
+      for (size_t i = 0; i < num_dropped; i++) {
+        pending_.push_front(std::move(batch_.back()));
+        batch_.pop_back();
+      }
+      text_.clear();
+      for (const auto &line : batch_) {
+        if (!text_.empty()) {
+          text_ += '\n';
+        }
+        text_ += line;
+      }
+    }
+  }
+
+  /// Size of the text of the last packet which was built.
+  size_t text_size() const { return text_.size(); }
+  /// Size of the payload (the text, possibly compressed) of the last packet.
+  size_t payload_size() const { return payload_size_; }
+
+private:
+  /// Write the header (unless it has no flags) followed by the text.
+  void write_text(const PacketHeader &header, std::vector<uint8_t> &packet) {
+    packet.resize(header.flags != 0 ? header.size() : 0);
+    if (!packet.empty()) {
+      header.serialize(packet.data(), packet.size());
+    }
+    packet.insert(packet.end(), text_.begin(), text_.end());
+    payload_size_ = text_.size();
+  }
+
+  const Options &options_;
+  std::deque<std::string> pending_; ///< Lines taken from the source, but not sent yet
+  std::vector<std::string> batch_;
+  std::string text_;
+  size_t payload_size_{0};
+};
+
+static int open_socket(const Options &options, sockaddr_in &address) {
+  address = {};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(options.port);
+  if (!parse_address(options.ip, address.sin_addr)) {
+    return -1;
+  }
+  int sock = socket(AF_INET, options.tcp ? SOCK_STREAM : SOCK_DGRAM, 0);
+  if (sock < 0) {
+    std::perror("socket");
+    return -1;
+  }
+  if (!options.tcp && IN_MULTICAST(ntohl(address.sin_addr.s_addr))) {
+    // loop the packets back, so that listeners on this host get them too
+    in_addr interface;
+    uint8_t loop = 1;
+    if (!get_interface(options, interface) ||
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &interface, sizeof(interface)) < 0 ||
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) < 0) {
+      std::perror("multicast");
+      close(sock);
+      return -1;
+    }
+  }
+  if (options.tcp &&
+      connect(sock, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0) {
+    std::perror("connect");
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+/// Handle all of the acks which have arrived, without blocking.
+static void receive_acks(int sock, FlowControl &flow_control, Counters &counters) {
+  uint8_t buffer[64];
+  ssize_t received;
+  while ((received = recv(sock, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+    Ack ack;
+    if (ack.parse(buffer, received)) {
+      counters.acks++;
+      if (ack.has(Ack::DROPPED)) {
+        counters.dropped++;
+      }
+      flow_control.on_ack(ack);
+    }
+  }
+}
+
+/// Wait until an ack arrives, or for at most timeout.
+static void wait_for_acks(int sock, std::chrono::milliseconds timeout) {
+  pollfd fd{.fd = sock, .events = POLLIN, .revents = 0};
+  poll(&fd, 1, timeout.count());
+}
+
+static void run_sender(const Options &options, const std::vector<std::string> &file_lines,
+                       size_t index, Counters &counters) {
+  sockaddr_in address;
+  int sock = open_socket(options, address);
+  if (sock < 0) {
+    counters.errors++;
+    return;
+  }
+  LineSource source(file_lines, options, index);
+  const double rate = options.rate / options.senders;
+  uint64_t max_lines = options.count / options.senders;
+  if (options.count > 0 && index < options.count % options.senders) {
+    max_lines++;
+  }
+
+  PacketBuilder builder(options);
+  FlowControl flow_control({});
+  std::vector<uint8_t> packet;
+  packet.reserve(options.packet_size + 1);
+  uint64_t lines_sent = 0;
+  auto start = Clock::now();
+  while (running && (options.count == 0 || lines_sent < max_lines)) {
+    // follow an absolute schedule so that the rate doesn't drift, sending all
+    // the lines which are due in as few packets as possible
+    uint64_t due = UINT64_MAX;
+    if (rate > 0) {
+      double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+      auto expected = static_cast<uint64_t>(elapsed * rate);
+      due = expected > lines_sent ? expected - lines_sent : 0;
+      if (due == 0) {
+        auto next_line = start + std::chrono::duration<double>((lines_sent + 1) / rate);
+        std::this_thread::sleep_until(std::chrono::time_point_cast<Clock::duration>(next_line));
+        continue;
+      }
+    }
+    if (options.count > 0) {
+      due = std::min(due, max_lines - lines_sent);
+    }
+
+    PacketHeader header;
+    if (options.ack) {
+      receive_acks(sock, flow_control, counters);
+      if (!flow_control.can_send()) {
+        // out of credits, so wait for the display to catch up; the lines
+        // which become due meanwhile are sent together afterwards
+        wait_for_acks(sock, 1ms);
+        continue;
+      }
+      header.flags |= PacketHeader::ACK_REQUESTED;
+      header.sequence = flow_control.on_send();
+    }
+    if (options.timestamp) {
+      // any monotonic clock will do, the display estimates its offset
+      header.flags |= PacketHeader::TIMESTAMP;
+      header.timestamp =
+          std::chrono::duration_cast<std::chrono::microseconds>(Clock::now().time_since_epoch())
+              .count();
+    }
+    uint64_t lines_in_packet = builder.build(source, due, header, packet);
+
+    ssize_t sent;
+    if (options.tcp) {
+      // the stream has no packet boundaries, so terminate the last line
+      packet.push_back('\n');
+      sent = send(sock, packet.data(), packet.size(), MSG_NOSIGNAL);
+    } else {
+      sent = sendto(sock, packet.data(), packet.size(), 0,
+                    reinterpret_cast<const sockaddr *>(&address), sizeof(address));
+    }
+    if (sent < 0) {
+      counters.errors++;
+      if (options.tcp) {
+        std::perror("send");
+        break;
+      }
+    } else {
+      counters.packets++;
+      counters.bytes += sent;
+      counters.text_bytes += builder.text_size();
+      counters.payload_bytes += builder.payload_size();
+      counters.lines += lines_in_packet;
+    }
+    lines_sent += lines_in_packet;
+  }
+  if (options.ack) {
+    // collect the acks of the last packets
+    auto end = Clock::now() + 250ms;
+    while (flow_control.in_flight() > 0 && Clock::now() < end) {
+      wait_for_acks(sock, 10ms);
+      receive_acks(sock, flow_control, counters);
+    }
+    counters.timeouts += flow_control.num_timeouts();
+  }
+  close(sock);
+}
+
+/// Counts what a listener receives and reports its rate once a second.
+class ReceiveReport {
+public:
+  void add(uint64_t lines, uint64_t packets, uint64_t bytes) {
+    lines_ += lines;
+    packets_ += packets;
+    bytes_ += bytes;
+  }
+
+  /// Report the rate if a second passed, returning false once the duration is over.
+  bool update(const Options &options) {
+    auto now = Clock::now();
+    if (now - last_report_ >= 1s) {
+      double elapsed = std::chrono::duration<double>(now - last_report_).count();
+      std::printf("received %10.1f lines/s %10.1f packets/s %10.1f kB/s\n", lines_ / elapsed,
+                  packets_ / elapsed, bytes_ / elapsed / 1000);
+      std::fflush(stdout);
+      flush();
+      last_report_ = now;
+    }
+    return options.duration <= 0 || now - start_ < std::chrono::duration<double>(options.duration);
+  }
+
+  void print_total(const char *packets_name, uint64_t invalid) {
+    flush();
+    std::printf("total: %llu lines, %llu %s, %llu bytes, %llu invalid packets\n",
+                static_cast<unsigned long long>(total_lines_),
+                static_cast<unsigned long long>(total_packets_), packets_name,
+                static_cast<unsigned long long>(total_bytes_),
+                static_cast<unsigned long long>(invalid));
+  }
+
+private:
+  void flush() {
+    total_lines_ += lines_;
+    total_packets_ += packets_;
+    total_bytes_ += bytes_;
+    lines_ = packets_ = bytes_ = 0;
+  }
+
+  Clock::time_point start_{Clock::now()};
+  Clock::time_point last_report_{start_};
+  uint64_t lines_{0}, packets_{0}, bytes_{0};
+  uint64_t total_lines_{0}, total_packets_{0}, total_bytes_{0};
+};
+
+/// Receive newline separated lines from any number of TCP senders.
+static int run_tcp_listener(const Options &options) {
+  int sock = socket(AF_INET, SOCK_STREAM, 0);
+  if (sock < 0) {
+    std::perror("socket");
+    return 1;
+  }
+  int reuse = 1;
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(options.port);
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(sock, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0 ||
+      listen(sock, 16) < 0) {
+    std::perror("bind");
+    close(sock);
+    return 1;
+  }
+  std::printf("Listening on TCP port %u\n", options.port);
+
+  // the listening socket comes first, followed by the connections
+  std::vector<pollfd> fds{{.fd = sock, .events = POLLIN, .revents = 0}};
+  std::vector<char> buffer(65536);
+  ReceiveReport report;
+  while (running && report.update(options)) {
+    if (poll(fds.data(), fds.size(), 100) <= 0) {
+      continue;
+    }
+    if (fds[0].revents & POLLIN) {
+      int connection = accept(sock, nullptr, nullptr);
+      if (connection >= 0) {
+        fds.push_back({.fd = connection, .events = POLLIN, .revents = 0});
+      }
+    }
+    for (size_t i = 1; i < fds.size();) {
+      if (!fds[i].revents) {
+        i++;
+        continue;
+      }
+      ssize_t received = recv(fds[i].fd, buffer.data(), buffer.size(), 0);
+      if (received <= 0) {
+        close(fds[i].fd);
+        fds.erase(fds.begin() + i);
+        continue;
+      }
+      // the senders terminate every line, so this counts lines split across reads once
+      report.add(std::count(buffer.data(), buffer.data() + received, '\n'), 1, received);
+      i++;
+    }
+  }
+  for (const auto &fd : fds) {
+    close(fd.fd);
+  }
+  report.print_total("reads", 0);
+  return 0;
+}
+
+/// Credits the listener acks with, like a display with an empty queue.
+static constexpr uint16_t listener_credits = 16;
+
+static int run_listener(const Options &options) {
+  if (options.tcp) {
+    return run_tcp_listener(options);
+  }
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock < 0) {
+    std::perror("socket");
+    return 1;
+  }
+  int reuse = 1;
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  timeval timeout{.tv_sec = 0, .tv_usec = 100000};
+  setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(options.port);
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(sock, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0) {
+    std::perror("bind");
+    close(sock);
+    return 1;
+  }
+  if (!options.group.empty()) {
+    ip_mreq request{};
+    if (!parse_address(options.group, request.imr_multiaddr) ||
+        !get_interface(options, request.imr_interface) ||
+        setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &request, sizeof(request)) < 0) {
+      std::perror("join multicast group");
+      close(sock);
+      return 1;
+    }
+  }
+  std::printf("Listening on UDP port %u%s%s\n", options.port,
+              options.group.empty() ? "" : " and multicast group ", options.group.c_str());
+
+  std::vector<char> buffer(65536);
+  std::vector<char> decompressed(PacketHeader::max_uncompressed_size);
+  uint64_t invalid = 0;
+  ReceiveReport report;
+  while (running && report.update(options)) {
+    sockaddr_in sender{};
+    socklen_t sender_size = sizeof(sender);
+    ssize_t received = recvfrom(sock, buffer.data(), buffer.size(), 0,
+                                reinterpret_cast<sockaddr *>(&sender), &sender_size);
+    if (received > 0) {
+      const auto *data = reinterpret_cast<const uint8_t *>(buffer.data());
+      const char *text = buffer.data();
+      size_t text_size = received;
+      if (PacketHeader::is_binary(data, received)) {
+        // decode the packet the same way the display does
+        PacketHeader header;
+        size_t header_size = header.parse(data, received);
+        text_size = 0;
+        if (header_size > 0 && header.has(PacketHeader::COMPRESSED)) {
+          text_size = Lz4::decompress(data + header_size, received - header_size,
+                                      reinterpret_cast<uint8_t *>(decompressed.data()),
+                                      decompressed.size());
+          text = decompressed.data();
+        }
+        if (header_size > 0 && !header.has(PacketHeader::COMPRESSED)) {
+          text_size = received - header_size;
+          text = buffer.data() + header_size;
+        }
+        if (text_size == 0 || (header.has(PacketHeader::COMPRESSED) &&
+                               text_size != header.uncompressed_size)) {
+          invalid++;
+          text_size = 0;
+        } else if (header.has(PacketHeader::ACK_REQUESTED)) {
+          // the lines are counted right away, so the queue is always empty
+          Ack ack;
+          ack.sequence = header.sequence;
+          ack.credits = listener_credits;
+          uint8_t response[Ack::serialized_size];
+          ack.serialize(response, sizeof(response));
+          sendto(sock, response, sizeof(response), 0, reinterpret_cast<const sockaddr *>(&sender),
+                 sender_size);
+        }
+      }
+      uint64_t lines = text_size > 0 ? 1 + std::count(text, text + text_size, '\n') : 0;
+      report.add(lines, 1, received);
+    }
+  }
+  close(sock);
+  report.print_total("packets", invalid);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parse_options(argc, argv, options)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  std::signal(SIGINT, [](int) { running = false; });
+
+  if (options.listen) {
+    return run_listener(options);
+  }
+
+  std::vector<std::string> file_lines;
+  if (!options.file.empty()) {
+    std::ifstream file(options.file);
+    if (!file) {
+      std::fprintf(stderr, "Could not open %s\n", options.file.c_str());
+      return 1;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+      if (!line.empty()) {
+        file_lines.push_back(line);
+      }
+    }
+    if (file_lines.empty()) {
+      std::fprintf(stderr, "%s has no lines to send\n", options.file.c_str());
+      return 1;
+    }
+  }
+
+  std::printf("Sending to %s:%u over %s: %zu sender(s), target %.1f lines/s, %zu byte %spackets\n",
+              options.ip.c_str(), options.port, options.tcp ? "TCP" : "UDP", options.senders,
+              options.rate, options.packet_size, options.compress ? "compressed " : "");
+
+  Counters counters;
+  auto start = Clock::now();
+  std::vector<std::thread> senders;
+  std::atomic<size_t> finished{0};
+  for (size_t i = 0; i < options.senders; i++) {
+    senders.emplace_back([&, i]() {
+      run_sender(options, file_lines, i, counters);
+      finished++;
+    });
+  }
+
+  // report the achieved rate once a second until we're done
+  auto last_report = start;
+  uint64_t last_lines = 0, last_packets = 0, last_bytes = 0;
+  while (running && finished < options.senders) {
+    std::this_thread::sleep_for(10ms);
+    auto now = Clock::now();
+    bool done = options.duration > 0 &&
+                now - start >= std::chrono::duration<double>(options.duration);
+    if (now - last_report >= 1s || done) {
+      double elapsed = std::chrono::duration<double>(now - last_report).count();
+      uint64_t lines = counters.lines, packets = counters.packets, bytes = counters.bytes;
+      std::printf("sent %10.1f lines/s %10.1f packets/s %10.1f kB/s (errors: %llu)\n",
+                  (lines - last_lines) / elapsed, (packets - last_packets) / elapsed,
+                  (bytes - last_bytes) / elapsed / 1000,
+                  static_cast<unsigned long long>(counters.errors.load()));
+      std::fflush(stdout);
+      last_lines = lines;
+      last_packets = packets;
+      last_bytes = bytes;
+      last_report = now;
+    }
+    if (done) {
+      break;
+    }
+  }
+  running = false;
+  for (auto &sender : senders) {
+    sender.join();
+  }
+
+  double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+  std::printf("total: %llu lines, %llu packets, %llu bytes in %.2f s\n"
+              "achieved: %.1f lines/s, %.1f packets/s, %.1f kB/s (target %.1f lines/s)\n",
+              static_cast<unsigned long long>(counters.lines.load()),
+              static_cast<unsigned long long>(counters.packets.load()),
+              static_cast<unsigned long long>(counters.bytes.load()), elapsed,
+              counters.lines / elapsed, counters.packets / elapsed,
+              counters.bytes / elapsed / 1000, options.rate);
+  if (options.compress && counters.text_bytes > 0) {
+    // only the payloads, since the headers are sent with or without compression
+    std::printf("compression: %llu bytes of text in %llu bytes of payload (%.1f%%)\n",
+                static_cast<unsigned long long>(counters.text_bytes.load()),
+                static_cast<unsigned long long>(counters.payload_bytes.load()),
+                100.0 * counters.payload_bytes / counters.text_bytes);
+  }
+  if (options.ack) {
+    std::printf("acks: %llu received, %llu dropped by the display, %llu timeouts\n",
+                static_cast<unsigned long long>(counters.acks.load()),
+                static_cast<unsigned long long>(counters.dropped.load()),
+                static_cast<unsigned long long>(counters.timeouts.load()));
+  }
+  return counters.errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,217 @@
+// Viewer (decoder) for the screen mirror stream of the wireless debug display.
+//
+// Receives the redrawn areas of the display's screen on a UDP port,
+// reconstructs its framebuffer and writes it to an image (PPM) whenever a
+// frame is complete, at most every --interval seconds, while reporting the
+// frame rate and bandwidth. With --ip, it subscribes to the display itself
+// (and unsubscribes on exit).
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "mirror_rect.hpp"
+
+using namespace std::chrono_literals;
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  size_t port{5557};          ///< Port to receive the stream on
+  std::string ip;             ///< Address of the display to subscribe to
+  size_t display_port{5555};  ///< Port of the display
+  std::string output{"mirror.ppm"}; ///< Image the framebuffer is written to
+  double interval{1};         ///< Minimum seconds between writing the image
+  double duration{0};         ///< Seconds to run for, 0 for no limit
+};
+
+static std::atomic<bool> running{true};
+
+static void print_usage(const char *name) {
+  std::printf(
+      "Usage: %s [options]\n"
+      "  --port <port>         port to receive the stream on (default 5557)\n"
+      "  --ip <address>        subscribe to the display at this address, instead of\n"
+      "                        waiting for a stream requested elsewhere\n"
+      "  --display-port <port> port of the display (default 5555)\n"
+      "  --output <path>       image (PPM) to write the screen to (default mirror.ppm)\n"
+      "  --interval <s>        minimum seconds between writing the image (default 1)\n"
+      "  --duration <s>        seconds to run for, 0 for no limit (default 0)\n",
+      name);
+}
+
+static bool parse_options(int argc, char **argv, Options &options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--help" || arg == "-h" || i + 1 >= argc) {
+      return false;
+    }
+    const char *v = argv[++i];
+    if (arg == "--port") {
+      options.port = std::atoi(v);
+    } else if (arg == "--ip") {
+      options.ip = v;
+    } else if (arg == "--display-port") {
+      options.display_port = std::atoi(v);
+    } else if (arg == "--output") {
+      options.output = v;
+    } else if (arg == "--interval") {
+      options.interval = std::atof(v);
+    } else if (arg == "--duration") {
+      options.duration = std::atof(v);
+    } else {
+      std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool send_command(const Options &options, const std::string &command) {
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(options.display_port);
+  if (inet_pton(AF_INET, options.ip.c_str(), &address.sin_addr) != 1) {
+    std::fprintf(stderr, "Invalid address %s\n", options.ip.c_str());
+    return false;
+  }
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock < 0) {
+    std::perror("socket");
+    return false;
+  }
+  // the display sends the stream back to the address this comes from
+  bool sent = sendto(sock, command.data(), command.size(), 0,
+                     reinterpret_cast<const sockaddr *>(&address), sizeof(address)) >= 0;
+  if (!sent) {
+    std::perror("sendto");
+  }
+  close(sock);
+  return sent;
+}
+
+static bool write_ppm(const std::string &path, const std::vector<uint16_t> &framebuffer,
+                      size_t width, size_t height) {
+  FILE *file = std::fopen(path.c_str(), "wb");
+  if (!file) {
+    std::perror("fopen");
+    return false;
+  }
+  std::fprintf(file, "P6\n%zu %zu\n255\n", width, height);
+  std::vector<uint8_t> row(width * 3);
+  for (size_t y = 0; y < height; y++) {
+    for (size_t x = 0; x < width; x++) {
+      // RGB565, expanded to 8 bits per channel
+      uint16_t pixel = framebuffer[y * width + x];
+      uint8_t r = (pixel >> 11) & 0x1f;
+      uint8_t g = (pixel >> 5) & 0x3f;
+      uint8_t b = pixel & 0x1f;
+      row[x * 3 + 0] = (r << 3) | (r >> 2);
+      row[x * 3 + 1] = (g << 2) | (g >> 4);
+      row[x * 3 + 2] = (b << 3) | (b >> 2);
+    }
+    std::fwrite(row.data(), 1, row.size(), file);
+  }
+  std::fclose(file);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  if (!parse_options(argc, argv, options)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  std::signal(SIGINT, [](int) { running = false; });
+
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock < 0) {
+    std::perror("socket");
+    return 1;
+  }
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(options.port);
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(sock, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0) {
+    std::perror("bind");
+    close(sock);
+    return 1;
+  }
+  if (!options.ip.empty() && !send_command(options, "+++MR:" + std::to_string(options.port))) {
+    close(sock);
+    return 1;
+  }
+  std::printf("Receiving the mirror stream on UDP port %zu\n", options.port);
+
+  std::vector<uint8_t> buffer(65536);
+  std::vector<uint16_t> framebuffer;
+  size_t width = 0, height = 0;
+  size_t frames = 0, packets = 0, bytes = 0, pixels = 0, invalid = 0;
+  auto start = Clock::now();
+  auto last_report = start;
+  auto last_write = start - 1h;
+  bool has_unwritten_frame = false;
+  while (running) {
+    pollfd fd{.fd = sock, .events = POLLIN, .revents = 0};
+    if (poll(&fd, 1, 100) > 0) {
+      ssize_t received = recv(sock, buffer.data(), buffer.size(), 0);
+      MirrorRect rect;
+      if (received > 0 && rect.parse(buffer.data(), received)) {
+        if (rect.screen_width != width || rect.screen_height != height) {
+          width = rect.screen_width;
+          height = rect.screen_height;
+          framebuffer.assign(width * height, 0);
+        }
+        if (rect.decode(buffer.data(), received, framebuffer.data())) {
+          packets++;
+          bytes += received;
+          pixels += rect.width * rect.height;
+          if (rect.has(MirrorRect::FRAME_END)) {
+            frames++;
+            has_unwritten_frame = true;
+          }
+        } else {
+          invalid++;
+        }
+      } else if (received > 0) {
+        invalid++;
+      }
+    }
+    auto now = Clock::now();
+    if (has_unwritten_frame && now - last_write >= std::chrono::duration<double>(options.interval)) {
+      write_ppm(options.output, framebuffer, width, height);
+      has_unwritten_frame = false;
+      last_write = now;
+    }
+    if (now - last_report >= 1s) {
+      double elapsed = std::chrono::duration<double>(now - last_report).count();
+      std::printf("%zux%zu: %6.1f frames/s %8.1f kB/s %6.1f%% of the screen/s, %zu invalid\n",
+                  width, height, frames / elapsed, bytes / elapsed / 1000,
+                  width * height > 0 ? 100.0 * pixels / (width * height) / elapsed : 0.0, invalid);
+      std::fflush(stdout);
+      frames = packets = bytes = pixels = 0;
+      last_report = now;
+    }
+    if (options.duration > 0 && now - start >= std::chrono::duration<double>(options.duration)) {
+      break;
+    }
+  }
+  if (has_unwritten_frame) {
+    write_ppm(options.output, framebuffer, width, height);
+  }
+  if (!options.ip.empty()) {
+    send_command(options, "+++MR:off");
+  }
+  close(sock);
+  return 0;
+}
@@ -0,0 +1,262 @@
+// Checks of the wire format shared by the display and the host tools, run with
+// ctest (or directly) after building the host tools.
+
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "flow_control.hpp"
+#include "lz4.hpp"
+#include "mirror_rect.hpp"
+#include "packet.hpp"
+#include "series_record.hpp"
+
+static int num_failures = 0;
+
+#define CHECK(condition)                                                                           \
+  do {                                                                                             \
+    if (!(condition)) {                                                                            \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);           \
+      num_failures++;                                                                              \
+    }                                                                                              \
+  } while (0)
+
+static std::vector<uint8_t> compress(const std::vector<uint8_t> &data) {
+  std::vector<uint8_t> compressed(Lz4::max_compressed_size(data.size()));
+  compressed.resize(Lz4::compress(data.data(), data.size(), compressed.data(), compressed.size()));
+  return compressed;
+}
+
+static void test_lz4_round_trip() {
+  std::mt19937 rng(1);
+  std::string text;
+  for (int i = 0; text.size() < 4000; i++) {
+    text += "motors/speed" + std::to_string(i % 4) + "::" + std::to_string(rng() % 2000) + "\n";
+  }
+  std::vector<uint8_t> random(3000);
+  for (auto &byte : random) {
+    byte = rng();
+  }
+  const std::vector<std::vector<uint8_t>> inputs = {
+      std::vector<uint8_t>(text.begin(), text.end()), random, std::vector<uint8_t>(1000, 'a'),
+      {'x'}, std::vector<uint8_t>(13, 'b')};
+  for (const auto &input : inputs) {
+    auto compressed = compress(input);
+    CHECK(!compressed.empty());
+    std::vector<uint8_t> output(input.size());
+    CHECK(Lz4::decompress(compressed.data(), compressed.size(), output.data(), output.size()) ==
+          input.size());
+    CHECK(output == input);
+    // the output must fit, even by one byte
+    if (input.size() > 1) {
+      CHECK(Lz4::decompress(compressed.data(), compressed.size(), output.data(),
+                            output.size() - 1) == 0);
+    }
+  }
+  // text compresses well
+  CHECK(compress(inputs[0]).size() < inputs[0].size() / 2);
+  // and the compressed size must fit
+  std::vector<uint8_t> small(16);
+  CHECK(Lz4::compress(random.data(), random.size(), small.data(), small.size()) == 0);
+}
+
+static void test_lz4_malformed() {
+  std::string text = "plot::1\nplot::2\nplot::3\nplot::1\nplot::2\nplot::3\nsome log line\n";
+  std::vector<uint8_t> input(text.begin(), text.end());
+  auto compressed = compress(input);
+  std::vector<uint8_t> output(PacketHeader::max_uncompressed_size);
+  // truncated blocks never decode to the whole input
+  for (size_t size = 0; size < compressed.size(); size++) {
+    CHECK(Lz4::decompress(compressed.data(), size, output.data(), output.size()) != input.size());
+  }
+  // garbage never writes past the output, or reads past the input
+  std::mt19937 rng(2);
+  for (int i = 0; i < 10000; i++) {
+    std::vector<uint8_t> garbage(1 + rng() % 64);
+    for (auto &byte : garbage) {
+      byte = rng();
+    }
+    CHECK(Lz4::decompress(garbage.data(), garbage.size(), output.data(), output.size()) <=
+          output.size());
+  }
+  // a match reaching back before the start of the output
+  const uint8_t bad_offset[] = {0x10, 'a', 0x05, 0x00, 0x00};
+  CHECK(Lz4::decompress(bad_offset, sizeof(bad_offset), output.data(), output.size()) == 0);
+}
+
+static void test_packet_header() {
+  const uint8_t all_flags =
+      PacketHeader::COMPRESSED | PacketHeader::ACK_REQUESTED | PacketHeader::TIMESTAMP;
+  for (uint8_t flags = 0; flags <= all_flags; flags++) {
+    PacketHeader header;
+    header.flags = flags;
+    header.uncompressed_size = 0xbeef;
+    header.sequence = 0xdeadbeef;
+    header.timestamp = 0x0123456789abcdef;
+    uint8_t data[32];
+    size_t size = header.serialize(data, sizeof(data));
+    CHECK(size == header.size());
+    CHECK(PacketHeader::is_binary(data, size));
+    CHECK(header.serialize(data, size - 1) == 0);
+
+    PacketHeader parsed;
+    CHECK(parsed.parse(data, size) == size);
+    CHECK(parsed.flags == flags);
+    CHECK(!parsed.has(PacketHeader::COMPRESSED) || parsed.uncompressed_size == 0xbeef);
+    CHECK(!parsed.has(PacketHeader::ACK_REQUESTED) || parsed.sequence == 0xdeadbeef);
+    CHECK(!parsed.has(PacketHeader::TIMESTAMP) || parsed.timestamp == 0x0123456789abcdef);
+    // truncated headers are invalid
+    CHECK(parsed.parse(data, size - 1) == 0);
+  }
+  // unknown flags are invalid, since the payload can't be found
+  const uint8_t unknown[] = {PacketHeader::start_byte, PacketHeader::magic, 0x80, 0, 0, 0, 0};
+  PacketHeader header;
+  CHECK(header.parse(unknown, sizeof(unknown)) == 0);
+  // text is never binary
+  const uint8_t text[] = {'W', 'x', 0};
+  CHECK(!PacketHeader::is_binary(text, sizeof(text)));
+}
+
+static void test_ack() {
+  Ack ack;
+  ack.flags = Ack::DROPPED;
+  ack.sequence = 0x89abcdef;
+  ack.queue_depth = 12;
+  ack.credits = 4;
+  uint8_t data[Ack::serialized_size];
+  CHECK(ack.serialize(data, sizeof(data)) == Ack::serialized_size);
+  CHECK(ack.serialize(data, sizeof(data) - 1) == 0);
+  Ack parsed;
+  CHECK(parsed.parse(data, sizeof(data)));
+  CHECK(parsed.has(Ack::DROPPED) && parsed.sequence == 0x89abcdef);
+  CHECK(parsed.queue_depth == 12 && parsed.credits == 4);
+  CHECK(!parsed.parse(data, sizeof(data) - 1));
+}
+
+/// Flow control whose sequence numbers are about to wrap around.
+class WrappingFlowControl : public FlowControl {
+public:
+  WrappingFlowControl()
+      : FlowControl({.initial_credits = 4}) {
+    next_sequence_ = UINT32_MAX - 1;
+    last_acked_ = UINT32_MAX - 2;
+  }
+};
+
+static Ack make_ack(uint32_t sequence, uint16_t credits) {
+  Ack ack;
+  ack.sequence = sequence;
+  ack.credits = credits;
+  return ack;
+}
+
+static void test_flow_control_wrap() {
+  auto now = FlowControl::Clock::now();
+  WrappingFlowControl flow_control;
+  std::vector<uint32_t> sequences;
+  while (flow_control.can_send(now)) {
+    sequences.push_back(flow_control.on_send(now));
+  }
+  CHECK(sequences == (std::vector<uint32_t>{UINT32_MAX - 1, UINT32_MAX, 0, 1}));
+  CHECK(flow_control.in_flight() == 4);
+
+  // an ack across the wrap frees the credits
+  flow_control.on_ack(make_ack(0, 2), now);
+  CHECK(flow_control.in_flight() == 1);
+  CHECK(flow_control.credits() == 2);
+  CHECK(flow_control.can_send(now));
+
+  // older (from before the wrap) and not yet sent sequences are ignored
+  flow_control.on_ack(make_ack(UINT32_MAX, 16), now);
+  flow_control.on_ack(make_ack(2, 16), now);
+  CHECK(flow_control.in_flight() == 1);
+  CHECK(flow_control.credits() == 2);
+
+  flow_control.on_ack(make_ack(1, 8), now);
+  CHECK(flow_control.in_flight() == 0);
+  CHECK(flow_control.credits() == 8);
+
+  // without acks, a probe is only sent after the timeout
+  for (int i = 0; i < 8; i++) {
+    flow_control.on_send(now);
+  }
+  CHECK(!flow_control.can_send(now));
+  CHECK(flow_control.can_send(now + std::chrono::milliseconds(250)));
+}
+
+static void test_series_record() {
+  std::vector<int32_t> samples = {0, -1, INT32_MIN, INT32_MAX, 42};
+  uint8_t data[64];
+  size_t record_size;
+  CHECK(SeriesRecord::serialize("motors/speed", samples.data(), samples.size(), data,
+                                sizeof(data), record_size) == samples.size());
+  std::string name;
+  std::vector<int32_t> parsed;
+  CHECK(SeriesRecord::parse(data, record_size, name, parsed) == record_size);
+  CHECK(name == "motors/speed" && parsed == samples);
+  CHECK(SeriesRecord::parse(data, record_size - 1, name, parsed) == 0);
+  // only as many samples as fit are written
+  CHECK(SeriesRecord::serialize("motors/speed", samples.data(), samples.size(), data,
+                                SeriesRecord::header_size("motors/speed") + 8,
+                                record_size) == 2);
+}
+
+static void test_mirror_rect() {
+  const size_t width = 40, height = 30;
+  std::vector<uint16_t> screen(width * height);
+  std::mt19937 rng(3);
+  for (size_t i = 0; i < screen.size(); i++) {
+    // runs of equal pixels, with some noise
+    screen[i] = (i / 7) % 5 == 0 ? rng() : 0x1234 * ((i / 13) % 3);
+  }
+  // encode a rectangle in packets too small for all of it, as the display does
+  const size_t rect_x = 5, rect_y = 3, rect_width = 30, rect_height = 20;
+  std::vector<uint16_t> mirror(width * height);
+  size_t row = 0;
+  while (row < rect_height) {
+    MirrorRect rect;
+    rect.screen_width = width;
+    rect.screen_height = height;
+    rect.x = rect_x;
+    rect.y = rect_y + row;
+    rect.width = rect_width;
+    uint8_t data[300];
+    size_t size = rect.encode(&screen[rect.y * width + rect_x], width, rect_height - row, data,
+                              sizeof(data));
+    CHECK(size > 0 && rect.height > 0);
+    if (size == 0 || rect.height == 0) {
+      return;
+    }
+    MirrorRect parsed;
+    CHECK(parsed.parse(data, size));
+    CHECK(parsed.decode(data, size, mirror.data()));
+    // truncated runs are malformed
+    CHECK(!parsed.decode(data, size - 1, mirror.data()));
+    row += rect.height;
+  }
+  for (size_t y = 0; y < height; y++) {
+    for (size_t x = 0; x < width; x++) {
+      bool inside = x >= rect_x && x < rect_x + rect_width && y >= rect_y &&
+                    y < rect_y + rect_height;
+      CHECK(mirror[y * width + x] == (inside ? screen[y * width + x] : 0));
+    }
+  }
+}
+
+int main() {
+  test_lz4_round_trip();
+  test_lz4_malformed();
+  test_packet_header();
+  test_ack();
+  test_flow_control_wrap();
+  test_series_record();
+  test_mirror_rect();
+  if (num_failures > 0) {
+    std::fprintf(stderr, "%d checks failed\n", num_failures);
+    return 1;
+  }
+  std::printf("all checks passed\n");
+  return 0;
+}